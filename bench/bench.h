@@ -0,0 +1,31 @@
+#pragma once
+
+#include <stdio.h>
+#include <time.h>
+
+#include "gc.h"
+
+static inline double gb_now() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+typedef struct {
+    double start;
+    GC_word gc_no;
+} gb_timer;
+
+static inline void gb_start(gb_timer *timer) {
+    GC_gcollect();
+    timer->gc_no = GC_get_gc_no();
+    timer->start = gb_now();
+}
+
+// Print elapsed time, throughput in operations per second and the
+// number of collections that happened in between
+static inline void gb_report(gb_timer *timer, const char *name, size_t nops) {
+    double elapsed = gb_now() - timer->start;
+    printf("%-32s %10.3f ms %14.0f ops/s %8lu GCs\n", name, elapsed * 1e3,
+           nops / elapsed, (unsigned long) (GC_get_gc_no() - timer->gc_no));
+}
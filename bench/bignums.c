@@ -0,0 +1,65 @@
+#include <stdlib.h>
+
+#include "gc.h"
+
+#include "grim.h"
+#include "internal.h"
+#include "bench.h"
+
+
+// Computes n! with additions only, as k! is the sum of k copies of
+// (k-1)!.  Every step allocates a fresh bignum that dies immediately,
+// which is the pattern that grim_add produces on overflow.
+static grim_object factorial(int n, size_t *nops) {
+    grim_object acc = grim_integer_pack(1);
+    for (int k = 2; k <= n; k++) {
+        grim_object sum = acc;
+        for (int i = 1; i < k; i++)
+            sum = grim_add(sum, acc, false);
+        *nops += k - 1;
+        acc = sum;
+    }
+    return acc;
+}
+
+// Sums the harmonic series with exact rationals
+static grim_object harmonic(int n, size_t *nops) {
+    grim_object acc = grim_integer_pack(0);
+    for (int k = 1; k <= n; k++)
+        acc = grim_add(acc, grim_rational_pack(grim_integer_pack(1), grim_integer_pack(k)), false);
+    *nops += n;
+    return acc;
+}
+
+int main(int argc, char **argv) {
+    int n = argc > 1 ? atoi(argv[1]) : 300;
+    int rounds = argc > 2 ? atoi(argv[2]) : 20;
+
+    grim_init();
+    GC_start_performance_measurement();
+
+#ifdef GRIM_GMP_GC
+    printf("GMP allocator: collector (no finalizers)\n");
+#else
+    printf("GMP allocator: malloc (finalizers)\n");
+#endif
+
+    gb_timer timer;
+    size_t nops = 0;
+
+    gb_start(&timer);
+    for (int r = 0; r < rounds; r++)
+        factorial(n, &nops);
+    gb_report(&timer, "factorial", nops);
+
+    nops = 0;
+    gb_start(&timer);
+    for (int r = 0; r < rounds; r++)
+        harmonic(n * 4, &nops);
+    gb_report(&timer, "harmonic", nops);
+
+    printf("heap size %lu KiB, total GC time %lu ms\n",
+           (unsigned long) (GC_get_heap_size() / 1024),
+           GC_get_full_gc_total_time());
+    return 0;
+}
@@ -0,0 +1,127 @@
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "gc.h"
+
+#include "grim.h"
+#include "internal.h"
+#include "bench.h"
+
+
+// A table that is shared the simple way, behind one lock
+static pthread_mutex_t global_lock = PTHREAD_MUTEX_INITIALIZER;
+
+typedef struct {
+    grim_object table;
+    const grim_object *keys;
+    size_t nkeys;
+    size_t nops;
+    int writes;
+    bool locked;
+    int seed;
+    int nthreads;
+    size_t found;
+} worker;
+
+static inline uint64_t next_random(uint64_t *state) {
+    *state ^= *state << 13;
+    *state ^= *state >> 7;
+    *state ^= *state << 17;
+    return *state;
+}
+
+// Looks up random keys, and sets a given percentage of them instead
+static void *mixed(void *data) {
+    worker *wk = data;
+    uint64_t state = 0x9e3779b97f4a7c15 * (wk->seed + 1);
+    for (size_t i = 0; i < wk->nops; i++) {
+        uint64_t r = next_random(&state);
+        grim_object key = wk->keys[r % wk->nkeys];
+        bool write = (int) ((r >> 40) % 100) < wk->writes;
+        if (wk->locked)
+            pthread_mutex_lock(&global_lock);
+        if (write)
+            grim_hashtable_set(wk->table, key, grim_integer_pack(i));
+        else
+            wk->found += grim_hashtable_get(wk->table, key) != grim_undefined;
+        if (wk->locked)
+            pthread_mutex_unlock(&global_lock);
+    }
+    return NULL;
+}
+
+// Inserts its share of the keys, so that the table grows
+static void *insert(void *data) {
+    worker *wk = data;
+    for (size_t i = wk->seed; i < wk->nkeys; i += wk->nthreads) {
+        grim_object key = wk->keys[i];
+        if (wk->locked)
+            pthread_mutex_lock(&global_lock);
+        grim_hashtable_set(wk->table, key, grim_true);
+        if (wk->locked)
+            pthread_mutex_unlock(&global_lock);
+    }
+    return NULL;
+}
+
+static void run(const char *name, void *(*proc)(void *), grim_object table, const grim_object *keys,
+                size_t nkeys, size_t nops, int writes, int nthreads, bool locked) {
+    worker workers[nthreads];
+    pthread_t threads[nthreads];
+    for (int t = 0; t < nthreads; t++)
+        workers[t] = (worker) {table, keys, nkeys, nops, writes, locked, t, nthreads, 0};
+
+    gb_timer timer;
+    gb_start(&timer);
+    for (int t = 0; t < nthreads; t++)
+        pthread_create(&threads[t], NULL, proc, &workers[t]);
+    for (int t = 0; t < nthreads; t++)
+        pthread_join(threads[t], NULL);
+
+    char label[64];
+    snprintf(label, sizeof(label), "%s, %d thread%s%s", name, nthreads,
+             nthreads == 1 ? "" : "s", locked ? ", locked" : "");
+    gb_report(&timer, label, proc == insert ? nkeys : nops * nthreads);
+}
+
+// Shares one table of string keys between threads that mostly read it,
+// as a service would its lookup table, and then between threads that
+// fill it from empty.  Each is timed with a concurrent table, and with
+// an ordinary one behind a single lock.  Throughput is over all threads
+// together.
+int main(int argc, char **argv) {
+    size_t nkeys = argc > 1 ? strtoul(argv[1], NULL, 10) : 100000;
+    size_t nops = argc > 2 ? strtoul(argv[2], NULL, 10) : 1000000;
+    int maxthreads = argc > 3 ? atoi(argv[3]) : 8;
+
+    grim_init();
+
+    grim_object keys = grim_vector_create(nkeys);
+    grim_object *k = &I_vectorelt(keys, 0);
+    char name[64];
+    for (size_t i = 0; i < nkeys; i++) {
+        snprintf(name, sizeof(name), "key-%zu", i);
+        k[i] = grim_string_pack(name, NULL, false);
+    }
+
+    for (int locked = 0; locked < 2; locked++) {
+        grim_object table = locked ? grim_hashtable_create(nkeys) : grim_hashtable_create_concurrent(nkeys);
+        for (size_t i = 0; i < nkeys; i++)
+            grim_hashtable_set(table, k[i], grim_integer_pack(i));
+        for (int writes = 0; writes <= 50; writes = writes ? writes * 5 : 10) {
+            snprintf(name, sizeof(name), "%d%% writes", writes);
+            for (int nthreads = 1; nthreads <= maxthreads; nthreads *= 2)
+                run(name, mixed, table, k, nkeys, nops, writes, nthreads, locked);
+        }
+    }
+
+    for (int locked = 0; locked < 2; locked++)
+        for (int nthreads = 1; nthreads <= maxthreads; nthreads *= 2) {
+            grim_object table = locked ? grim_hashtable_create(0) : grim_hashtable_create_concurrent(0);
+            run("insert", insert, table, k, nkeys, 0, 0, nthreads, locked);
+        }
+
+    GC_reachable_here(keys);
+    return 0;
+}
@@ -0,0 +1,132 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "gc.h"
+#include "murmur.h"
+
+#include "grim.h"
+#include "internal.h"
+#include "bench.h"
+
+
+typedef uint64_t (*hasher)(const char *buf, size_t len, uint64_t h);
+
+// What grim_hash_bytes used to be, to compare with
+static uint64_t murmur(const char *buf, size_t len, uint64_t h) {
+    uint64_t out[2];
+    MurmurHash3_x86_128(buf, len, (uint32_t) h, out);
+    return out[1] + h;
+}
+
+static const struct {
+    const char *name;
+    hasher hash;
+} hashers[] = {
+    {"grim_hash_bytes", grim_hash_bytes},
+    {"murmur3", murmur},
+};
+
+static const size_t lengths[] = {
+    1, 2, 3, 4, 7, 8, 12, 16, 24, 32, 48, 64, 128, 256, 512, 1024, 2048, 4096,
+};
+
+#define NHASHERS (sizeof(hashers) / sizeof(hashers[0]))
+#define NLENGTHS (sizeof(lengths) / sizeof(lengths[0]))
+
+// Hashes len bytes over and over, from a few different offsets so that
+// loads aren't always aligned
+static void throughput(const char *name, hasher hash, const char *buf, size_t len, size_t nops) {
+    uint64_t sink = 0;
+    double start = gb_now();
+    for (size_t i = 0; i < nops; i++)
+        sink ^= hash(buf + (i & 15), len, i);
+    double elapsed = gb_now() - start;
+
+    char label[64];
+    snprintf(label, sizeof(label), "%s, %zu bytes", name, len);
+    printf("%-32s %10.3f ms %14.0f ops/s %10.3f GB/s\n", label, elapsed * 1e3,
+           nops / elapsed, nops * len / elapsed * 1e-9);
+    GC_reachable_here((void *) sink);
+}
+
+// Chi-squared of bucket counts over its degrees of freedom, which is
+// close to 1 if keys are spread as if at random
+static double chi2(const uint32_t *counts, size_t nbuckets, size_t nkeys) {
+    double expected = (double) nkeys / nbuckets, sum = 0;
+    for (size_t i = 0; i < nbuckets; i++)
+        sum += (counts[i] - expected) * (counts[i] - expected) / expected;
+    return sum / (nbuckets - 1);
+}
+
+// Hashes keys of len bytes that count up from zero, written at the
+// start or at the end of otherwise constant bytes, and buckets them by
+// the low bits of the hash, the bits hash tables pick slots by, and
+// the high bits.  Short keys have only so many values.
+static void distribution(const char *name, hasher hash, size_t len, bool atend, size_t maxkeys) {
+    size_t nkeys = maxkeys;
+    if (len < 8 && ((size_t) 1 << (8 * len)) < nkeys)
+        nkeys = (size_t) 1 << (8 * len);
+    int bits = 0;
+    while (((size_t) 4 << bits) < nkeys)
+        bits++;
+    size_t nbuckets = (size_t) 1 << bits;
+
+    uint32_t *low = calloc(nbuckets, sizeof(uint32_t));
+    uint32_t *mid = calloc(nbuckets, sizeof(uint32_t));
+    uint32_t *high = calloc(nbuckets, sizeof(uint32_t));
+    char *key = malloc(len);
+    memset(key, 'k', len);
+
+    for (size_t i = 0; i < nkeys; i++) {
+        size_t n = len < sizeof(i) ? len : sizeof(i);
+        memcpy(atend ? key + len - n : key, &i, n);
+        uint64_t h = hash(key, len, 0);
+        low[h & (nbuckets - 1)]++;
+        mid[(h >> 7) & (nbuckets - 1)]++;
+        high[h >> (64 - bits)]++;
+    }
+
+    char label[64];
+    snprintf(label, sizeof(label), "%s, %zu bytes, %s", name, len, atend ? "suffix" : "prefix");
+    printf("%-40s %8zu %10.3f %10.3f %10.3f\n", label, nkeys,
+           chi2(low, nbuckets, nkeys), chi2(mid, nbuckets, nkeys), chi2(high, nbuckets, nkeys));
+
+    free(low);
+    free(mid);
+    free(high);
+    free(key);
+}
+
+// Times hashing of keys from 1 to 4096 bytes long, and checks how
+// evenly keys that differ in only a few bytes are spread over buckets.
+// Throughput is given per hash and per byte.  Spread is given as
+// chi-squared per degree of freedom, with four keys per bucket; values
+// much above 1 mean some buckets get more than their share.
+int main(int argc, char **argv) {
+    size_t nops = argc > 1 ? strtoul(argv[1], NULL, 10) : 5000000;
+    size_t nbytes = argc > 2 ? strtoul(argv[2], NULL, 10) : 500000000;
+    size_t nkeys = argc > 3 ? strtoul(argv[3], NULL, 10) : 1 << 18;
+
+    grim_init();
+
+    size_t size = lengths[NLENGTHS - 1] + 16;
+    char *buf = malloc(size);
+    for (size_t i = 0; i < size; i++)
+        buf[i] = (char) (i * 0x9e3779b97f4a7c15 >> 56);
+
+    for (size_t h = 0; h < NHASHERS; h++)
+        for (size_t l = 0; l < NLENGTHS; l++) {
+            size_t n = nbytes / lengths[l] < nops ? nbytes / lengths[l] : nops;
+            throughput(hashers[h].name, hashers[h].hash, buf, lengths[l], n);
+        }
+
+    printf("\n%-40s %8s %10s %10s %10s\n", "chi2/df", "keys", "low", "slot", "high");
+    for (size_t h = 0; h < NHASHERS; h++)
+        for (size_t l = 0; l < NLENGTHS; l++)
+            for (int atend = 0; atend < 2; atend++)
+                distribution(hashers[h].name, hashers[h].hash, lengths[l], atend, nkeys);
+
+    free(buf);
+    return 0;
+}
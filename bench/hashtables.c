@@ -0,0 +1,236 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "gc.h"
+
+#include "grim.h"
+#include "internal.h"
+#include "bench.h"
+
+
+// Keys are looked up in a different order from the one they were
+// inserted in, as they would be in practice
+static void shuffle(grim_object *keys, size_t n) {
+    for (size_t i = n - 1; i > 0; i--) {
+        size_t j = rand() % (i + 1);
+        grim_object tmp = keys[i];
+        keys[i] = keys[j];
+        keys[j] = tmp;
+    }
+}
+
+static void run(const char *name, grim_object *keys, grim_object *misses, size_t n, int rounds) {
+    char label[64];
+    gb_timer timer;
+
+    grim_object table = grim_hashtable_create(0);
+    gb_start(&timer);
+    for (size_t i = 0; i < n; i++)
+        grim_hashtable_set(table, keys[i], grim_integer_pack(i));
+    snprintf(label, sizeof(label), "%s: insert", name);
+    gb_report(&timer, label, n);
+    shuffle(keys, n);
+
+    size_t found = 0;
+    gb_start(&timer);
+    for (int r = 0; r < rounds; r++)
+        for (size_t i = 0; i < n; i++)
+            found += grim_hashtable_get(table, keys[i]) != grim_undefined;
+    snprintf(label, sizeof(label), "%s: hit", name);
+    gb_report(&timer, label, n * rounds);
+
+    gb_start(&timer);
+    for (int r = 0; r < rounds; r++)
+        for (size_t i = 0; i < n; i++)
+            found += grim_hashtable_has(table, misses[i]);
+    snprintf(label, sizeof(label), "%s: miss", name);
+    gb_report(&timer, label, n * rounds);
+
+    gb_start(&timer);
+    grim_object key, value;
+    size_t seen = 0;
+    for (int r = 0; r < rounds; r++)
+        for (size_t pos = 0; grim_hashtable_next(table, &pos, &key, &value);)
+            seen++;
+    snprintf(label, sizeof(label), "%s: iterate", name);
+    gb_report(&timer, label, seen);
+
+    gb_start(&timer);
+    for (size_t i = 0; i < n; i++)
+        grim_hashtable_unset(table, keys[i]);
+    for (size_t i = 0; i < n; i++)
+        grim_hashtable_set(table, misses[i], grim_true);
+    snprintf(label, sizeof(label), "%s: delete, reinsert", name);
+    gb_report(&timer, label, 2 * n);
+
+    if (found != n * rounds)
+        printf("wrong result: %zu\n", found);
+}
+
+// The longest any single insert takes, which is when the table grows.
+// Collection is off, so as not to measure that instead.
+static void latency(const char *name, grim_object *keys, size_t n) {
+    grim_object table = grim_hashtable_create(0);
+    double worst = 0.0;
+    GC_gcollect();
+    GC_disable();
+    for (size_t i = 0; i < n; i++) {
+        double start = gb_now();
+        grim_hashtable_set(table, keys[i], grim_true);
+        double elapsed = gb_now() - start;
+        if (elapsed > worst)
+            worst = elapsed;
+    }
+    GC_enable();
+    printf("%-32s %10.3f ms\n", name, worst * 1e3);
+}
+
+// Long strings that differ only at the end, and whose hashes agree on
+// the slot where probing starts and on the seven bits kept in the
+// control bytes, in a table of up to 1024 slots.  Looking one up means
+// going past all those before it.
+#define COLLISION_LENGTH (128)
+
+static void make_collisions(grim_object *keys, size_t n) {
+    char text[COLLISION_LENGTH + 1];
+    memset(text, 'x', COLLISION_LENGTH);
+    grim_object scratch = grim_nstring_pack(text, COLLISION_LENGTH, NULL, false);
+    uint64_t want = 0;
+    size_t found = 0;
+    for (unsigned long i = 0; found < n; i++) {
+        snprintf(text + COLLISION_LENGTH - 12, 13, "%012lu", i);
+        memcpy(I_str(scratch), text, COLLISION_LENGTH);
+        uint64_t hash = grim_hash(scratch, 0) & ((1024 << 7) - 1);
+        if (found == 0)
+            want = hash;
+        if (hash == want)
+            keys[found++] = grim_nstring_pack(text, COLLISION_LENGTH, NULL, false);
+    }
+}
+
+static void lookup(const char *name, grim_object table, grim_object *keys, size_t n, int rounds) {
+    gb_timer timer;
+    size_t found = 0;
+    gb_start(&timer);
+    for (int r = 0; r < rounds; r++)
+        for (size_t i = 0; i < n; i++)
+            found += grim_hashtable_has(table, keys[i]);
+    gb_report(&timer, name, n * rounds);
+    if (found != n * rounds)
+        printf("wrong result: %zu\n", found);
+}
+
+// Inserts, looks up and deletes fixnum, symbol and string keys, and
+// looks up module members, which is what the interpreter mostly does.
+// The slowest single insert is reported for fixnums.
+// String keys are looked up both as the same objects and as copies,
+// and then there are keys whose hashes collide, and many tables of four
+// entries each.
+int main(int argc, char **argv) {
+    size_t n = argc > 1 ? strtoul(argv[1], NULL, 10) : 100000;
+    int rounds = argc > 2 ? atoi(argv[2]) : 20;
+
+    grim_init();
+
+    grim_object keys = grim_vector_create(2 * n);
+    grim_object *k = &I_vectorelt(keys, 0);
+    char name[64];
+
+    for (size_t i = 0; i < 2 * n; i++)
+        k[i] = grim_integer_pack(i * 7919);
+    run("fixnum", k, k + n, n, rounds);
+    latency("fixnum: slowest insert", k, n);
+
+    for (size_t i = 0; i < 2 * n; i++) {
+        snprintf(name, sizeof(name), "symbol-%zu", i);
+        k[i] = grim_intern(name, NULL);
+    }
+    run("symbol", k, k + n, n, rounds);
+
+    for (size_t i = 0; i < 2 * n; i++) {
+        snprintf(name, sizeof(name), "a-somewhat-longer-key-%zu", i);
+        k[i] = grim_string_pack(name, NULL, false);
+    }
+    run("string", k, k + n, n, rounds);
+
+    // Long enough for hashing them to be most of the work
+    char longname[256];
+    memset(longname, 'x', sizeof(longname));
+    for (size_t i = 0; i < 2 * n; i++) {
+        int len = snprintf(longname, sizeof(longname), "%zu", i);
+        longname[len] = '-';
+        k[i] = grim_nstring_pack(longname, sizeof(longname), NULL, false);
+    }
+    run("long string", k, k + n, n, rounds);
+
+    grim_object table = grim_hashtable_create(0);
+    for (size_t i = 0; i < n; i++)
+        grim_hashtable_set(table, k[i], grim_true);
+    for (size_t i = 0; i < n; i++)
+        k[n + i] = grim_nstring_pack((const char *) I_str(k[i]), I_strlen(k[i]), NULL, false);
+    lookup("string: hit, copies", table, k + n, n, rounds);
+
+    size_t ncollisions = 64;
+    make_collisions(k, 2 * ncollisions);
+    table = grim_hashtable_create(0);
+    for (size_t i = 0; i < ncollisions; i++)
+        grim_hashtable_set(table, k[i], grim_true);
+    for (size_t i = 0; i < ncollisions; i++)
+        k[2 * ncollisions + i] = grim_nstring_pack((const char *) I_str(k[i]), COLLISION_LENGTH, NULL, false);
+    int crounds = rounds * n / ncollisions / 16;
+    lookup("collision: hit", table, k, ncollisions, crounds);
+    lookup("collision: hit, copies", table, k + 2 * ncollisions, ncollisions, crounds);
+    gb_timer timer;
+    size_t found = 0;
+    gb_start(&timer);
+    for (int r = 0; r < crounds; r++)
+        for (size_t i = 0; i < ncollisions; i++)
+            found += grim_hashtable_has(table, k[ncollisions + i]);
+    gb_report(&timer, "collision: miss", ncollisions * crounds);
+
+    // Many small tables, as records or options would be
+    grim_object fields[4];
+    for (size_t i = 0; i < 4; i++) {
+        snprintf(name, sizeof(name), "field-%zu", i);
+        fields[i] = grim_intern(name, NULL);
+    }
+    size_t nsmall = n / 4;
+    grim_heap_stats_t before, after;
+    grim_heap_stats(&before);
+    grim_object small = grim_vector_create(nsmall);
+    gb_start(&timer);
+    for (size_t i = 0; i < nsmall; i++) {
+        I_vectorelt(small, i) = grim_hashtable_create(0);
+        for (size_t j = 0; j < 4; j++)
+            grim_hashtable_set(I_vectorelt(small, i), fields[j], grim_integer_pack(i));
+    }
+    gb_report(&timer, "small: create", nsmall);
+    grim_heap_stats(&after);
+    printf("%-32s %10zu bytes\n", "small: size",
+           (after.types[GRIM_HASHTABLE].bytes - before.types[GRIM_HASHTABLE].bytes) / nsmall);
+    gb_start(&timer);
+    for (int r = 0; r < rounds; r++)
+        for (size_t i = 0; i < nsmall; i++)
+            for (size_t j = 0; j < 4; j++)
+                found += grim_hashtable_get(I_vectorelt(small, i), fields[j]) >> 1;
+    gb_report(&timer, "small: hit", 4 * nsmall * rounds);
+
+    // A module with a handful of members, as most are
+    for (size_t i = 0; i < 32; i++) {
+        snprintf(name, sizeof(name), "member-%zu", i);
+        k[i] = grim_intern(name, NULL);
+    }
+    grim_object module = grim_module_create(grim_intern("bench", NULL));
+    for (size_t i = 0; i < 32; i++)
+        grim_module_set(module, k[i], grim_integer_pack(i));
+    gb_start(&timer);
+    size_t sum = found;
+    for (int r = 0; r < rounds; r++)
+        for (size_t i = 0; i < n; i++)
+            sum += grim_module_get(module, k[i % 32]) >> 1;
+    gb_report(&timer, "module member", n * rounds);
+
+    GC_reachable_here(keys);
+    return sum == 0;
+}
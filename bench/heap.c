@@ -0,0 +1,86 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "gc.h"
+
+#include "grim.h"
+#include "internal.h"
+#include "bench.h"
+
+
+// Keeps a large heap of numbers, strings and buffers alive, and times
+// full collections over it.  None of these objects hold pointers to
+// anything but their own payloads, so the less of them the collector
+// scans, the faster it goes.
+static grim_object build_heap(size_t n) {
+    grim_object vec = grim_vector_create(4 * n);
+    for (size_t i = 0; i < n; i++) {
+        I_vectorelt(vec, 4 * i) = grim_float_pack(1e300 / (i + 1));
+
+        char digits[64];
+        for (size_t j = 0; j < sizeof(digits) - 1; j++)
+            digits[j] = '1' + rand() % 9;
+        digits[sizeof(digits) - 1] = 0;
+        I_vectorelt(vec, 4 * i + 1) = grim_integer_read(digits, 10);
+
+        char text[48];
+        for (size_t j = 0; j < sizeof(text); j++)
+            text[j] = 'a' + rand() % 26;
+        I_vectorelt(vec, 4 * i + 2) = grim_nstring_pack(text, sizeof(text), NULL, false);
+
+        grim_object buf = grim_buffer_create(0);
+        for (size_t j = 0; j < 128; j++) {
+            uint64_t word = ((uint64_t) rand() << 32) | rand();
+            grim_buffer_copy(buf, (const char *) &word, sizeof(word));
+        }
+        I_vectorelt(vec, 4 * i + 3) = buf;
+    }
+    return vec;
+}
+
+// Stores the address of each of n conses in a boxed float, then drops
+// the conses, and counts how many survive a collection
+static size_t false_retention(size_t n) {
+    void **links = malloc(n * sizeof(void *));
+    grim_object vec = grim_vector_create(n);
+    for (size_t i = 0; i < n; i++) {
+        grim_object cons = grim_cons_pack(grim_integer_pack(i), grim_nil);
+        double floating;
+        memcpy(&floating, &cons, sizeof(floating));
+        I_vectorelt(vec, i) = grim_float_pack(floating);
+        links[i] = (void *) (cons - GRIM_CONS_TAG);
+        GC_general_register_disappearing_link(&links[i], links[i]);
+    }
+
+    GC_gcollect();
+    size_t retained = 0;
+    for (size_t i = 0; i < n; i++)
+        if (links[i])
+            retained++;
+
+    GC_reachable_here(vec);
+    free(links);
+    return retained;
+}
+
+int main(int argc, char **argv) {
+    size_t n = argc > 1 ? strtoul(argv[1], NULL, 10) : 20000;
+    int rounds = argc > 2 ? atoi(argv[2]) : 20;
+
+    grim_init();
+
+    grim_object heap = build_heap(n);
+    GC_gcollect();
+    printf("heap size %zu KiB\n", GC_get_heap_size() / 1024);
+
+    gb_timer timer;
+    gb_start(&timer);
+    for (int r = 0; r < rounds; r++)
+        GC_gcollect();
+    gb_report(&timer, "full collection", rounds);
+
+    printf("conses kept alive by floats: %zu of %zu\n", false_retention(n), n);
+
+    GC_reachable_here(heap);
+    return 0;
+}
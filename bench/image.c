@@ -0,0 +1,88 @@
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/wait.h>
+
+#include "gc.h"
+
+#include "grim.h"
+#include "internal.h"
+#include "bench.h"
+
+
+// A library of n definitions, each a small vector of a number, a
+// string and a list with a symbol of its own
+static grim_object build_source(size_t n) {
+    grim_object buf = grim_buffer_create(0);
+    char line[128];
+    for (size_t i = 0; i < n; i++) {
+        int len = snprintf(line, sizeof(line),
+                           "(%%module-set! def-%zu #(%zu \"string number %zu\" (sym-%zu . 1.5)))\n",
+                           i, i, i, i);
+        grim_buffer_copy(buf, line, len);
+    }
+    return grim_nstring_pack(I_buf(buf), I_buflen(buf), NULL, false);
+}
+
+// Starts a fresh process, either from source or from an image, and
+// reports how long it took to get ready
+static void startup(const char *self, const char *mode, const char *path) {
+    double start = gb_now();
+    pid_t pid = fork();
+    if (pid == 0) {
+        execl(self, self, mode, path, (char *) NULL);
+        _exit(1);
+    }
+    int status;
+    waitpid(pid, &status, 0);
+    printf("%-32s %10.3f ms (process, %s)\n", mode, (gb_now() - start) * 1e3,
+           WIFEXITED(status) && WEXITSTATUS(status) == 0 ? "ok" : "failed");
+}
+
+int main(int argc, char **argv) {
+    if (argc == 3 && !strcmp(argv[1], "--image")) {
+        grim_object module = grim_init_image(argv[2]);
+        return module == grim_undefined || grim_module_get(module, grim_intern("def-0", NULL)) == grim_undefined;
+    }
+    if (argc == 3 && !strcmp(argv[1], "--source")) {
+        grim_init();
+        FILE *file = fopen(argv[2], "r");
+        grim_object module = grim_build_module(grim_intern("library", NULL), grim_read_file(file));
+        fclose(file);
+        return grim_module_get(module, grim_intern("def-0", NULL)) == grim_undefined;
+    }
+
+    size_t n = argc > 1 ? strtoul(argv[1], NULL, 10) : 20000;
+    int rounds = argc > 2 ? atoi(argv[2]) : 10;
+
+    grim_init();
+    grim_object source = build_source(n);
+    grim_object module = grim_undefined;
+
+    gb_timer timer;
+    gb_start(&timer);
+    for (int r = 0; r < rounds; r++)
+        module = grim_build_module(grim_intern("library", NULL), source);
+    gb_report(&timer, "build from source", n * rounds);
+
+    char image[] = "/tmp/bench-image-XXXXXX", text[] = "/tmp/bench-source-XXXXXX";
+    close(mkstemp(image));
+    close(mkstemp(text));
+    grim_image_save(image, module);
+    FILE *file = fopen(text, "w");
+    fwrite(I_str(source), 1, I_strlen(source), file);
+    fclose(file);
+
+    gb_start(&timer);
+    for (int r = 0; r < rounds; r++)
+        grim_image_load(image);
+    gb_report(&timer, "load image (merged)", n * rounds);
+
+    startup(argv[0], "--source", text);
+    startup(argv[0], "--image", image);
+
+    unlink(image);
+    unlink(text);
+    GC_reachable_here(module);
+    return 0;
+}
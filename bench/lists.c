@@ -0,0 +1,105 @@
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "gc.h"
+
+#include "grim.h"
+#include "internal.h"
+#include "bench.h"
+
+
+static grim_object build_list(size_t n) {
+    grim_object list = grim_nil;
+    for (size_t i = 0; i < n; i++)
+        list = grim_cons_pack(grim_integer_pack(i), list);
+    return list;
+}
+
+static grim_object build_source(size_t n) {
+    grim_object buf = grim_buffer_create(0);
+    grim_buffer_copy(buf, "(", 1);
+    for (size_t i = 0; i < n; i++)
+        grim_buffer_copy(buf, "(a b (c d) e) ", 14);
+    grim_buffer_copy(buf, ")", 1);
+    return grim_nstring_pack(I_buf(buf), I_buflen(buf), NULL, false);
+}
+
+// A data file of numeric forms: fixnums, floats and bignums
+static grim_object build_numbers(size_t n) {
+    grim_object buf = grim_buffer_create(0);
+    char line[96];
+    for (size_t i = 0; i < n; i++) {
+        int len = snprintf(line, sizeof(line), "(%zu %zu.%03zu 1%030zu)\n", i, i, i % 1000, i);
+        grim_buffer_copy(buf, line, len);
+    }
+    return grim_nstring_pack(I_buf(buf), I_buflen(buf), NULL, false);
+}
+
+// One vector literal of n fixnums
+static grim_object build_vector_source(size_t n) {
+    grim_object buf = grim_buffer_create(0);
+    grim_buffer_copy(buf, "#(", 2);
+    char word[32];
+    for (size_t i = 0; i < n; i++) {
+        int len = snprintf(word, sizeof(word), "%zu ", i);
+        grim_buffer_copy(buf, word, len);
+    }
+    grim_buffer_copy(buf, ")", 1);
+    return grim_nstring_pack(I_buf(buf), I_buflen(buf), NULL, false);
+}
+
+int main(int argc, char **argv) {
+    size_t n = argc > 1 ? strtoul(argv[1], NULL, 10) : 1000;
+    int rounds = argc > 2 ? atoi(argv[2]) : 1000;
+
+    grim_init();
+
+    gb_timer timer;
+    gb_start(&timer);
+    for (int r = 0; r < rounds; r++)
+        build_list(n);
+    gb_report(&timer, "cons", n * rounds);
+
+    grim_object source = build_source(n);
+    gb_start(&timer);
+    for (int r = 0; r < rounds / 10; r++)
+        grim_read(source);
+    gb_report(&timer, "read (conses)", 6 * n * (rounds / 10));
+
+    source = build_numbers(n);
+    gb_start(&timer);
+    for (int r = 0; r < rounds / 10; r++)
+        grim_read_all(source);
+    gb_report(&timer, "read_all (numbers)", 3 * n * (rounds / 10));
+
+    source = build_vector_source(10 * n);
+    gb_start(&timer);
+    for (int r = 0; r < rounds / 10; r++)
+        grim_read(source);
+    gb_report(&timer, "read (vector)", 10 * n * (rounds / 10));
+
+    gb_start(&timer);
+    for (int r = 0; r < rounds; r++) {
+        grim_object vec = grim_vector_create(0);
+        for (size_t i = 0; i < n; i++)
+            grim_vector_push(vec, grim_integer_pack(i));
+    }
+    gb_report(&timer, "vector push", n * rounds);
+
+    // A variadic function that returns its rest argument, so each call
+    // packs its arguments into a fresh list
+    const char code[] = { GRIM_BC_LOAD_ARG, 0, GRIM_BC_RETURN };
+    grim_object bytecode = grim_buffer_create(0);
+    grim_buffer_copy(bytecode, code, sizeof(code));
+    grim_object func = grim_lfunc_create(bytecode, grim_vector_create(0), 0, 0, true);
+    grim_object args[8];
+    for (int i = 0; i < 8; i++)
+        args[i] = grim_integer_pack(i);
+
+    gb_start(&timer);
+    for (int r = 0; r < rounds * 10; r++)
+        grim_call(func, 8, args);
+    gb_report(&timer, "variadic call (8 args)", rounds * 10);
+
+    return 0;
+}
@@ -0,0 +1,58 @@
+#include <stdlib.h>
+
+#include "gc.h"
+
+#include "grim.h"
+#include "internal.h"
+#include "bench.h"
+
+
+// Sums the same numbers, stored once as boxed floats in a generic
+// vector, and once unboxed in an f64vector
+static grim_object boxed_sum(grim_object vec) {
+    grim_object acc = grim_float_pack(0.0);
+    for (size_t i = 0; i < I_vectorlen(vec); i++)
+        acc = grim_add(acc, I_vectorelt(vec, i), false);
+    return acc;
+}
+
+int main(int argc, char **argv) {
+    size_t n = argc > 1 ? strtoul(argv[1], NULL, 10) : 100000;
+    int rounds = argc > 2 ? atoi(argv[2]) : 100;
+
+    grim_init();
+
+    grim_object boxed = grim_vector_create(n);
+    grim_object flat = grim_f64vector_create(n);
+    grim_object bytes = grim_bytevector_create(n);
+    for (size_t i = 0; i < n; i++) {
+        double x = (double) rand() / RAND_MAX;
+        I_vectorelt(boxed, i) = grim_float_pack(x);
+        I_f64data(flat)[i] = x;
+        I_u8data(bytes)[i] = rand();
+    }
+
+    gb_timer timer;
+    gb_start(&timer);
+    for (int r = 0; r < rounds; r++)
+        boxed_sum(boxed);
+    gb_report(&timer, "sum, boxed floats", n * rounds);
+
+    gb_start(&timer);
+    for (int r = 0; r < rounds; r++)
+        grim_numvector_sum(flat);
+    gb_report(&timer, "sum, f64vector", n * rounds);
+
+    gb_start(&timer);
+    for (int r = 0; r < rounds; r++)
+        grim_numvector_dot(flat, flat);
+    gb_report(&timer, "dot, f64vector", n * rounds);
+
+    gb_start(&timer);
+    for (int r = 0; r < rounds; r++)
+        grim_numvector_dot(bytes, bytes);
+    gb_report(&timer, "dot, bytevector", n * rounds);
+
+    GC_reachable_here(boxed);
+    return 0;
+}
@@ -0,0 +1,42 @@
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "gc.h"
+
+#include "grim.h"
+#include "internal.h"
+#include "bench.h"
+
+
+// Interns a large number of symbols, then looks them up again and
+// times full collections of a heap that holds little else
+int main(int argc, char **argv) {
+    size_t n = argc > 1 ? strtoul(argv[1], NULL, 10) : 50000;
+    int rounds = argc > 2 ? atoi(argv[2]) : 20;
+
+    grim_init();
+
+    char name[32];
+    gb_timer timer;
+    gb_start(&timer);
+    for (size_t i = 0; i < n; i++) {
+        snprintf(name, sizeof(name), "symbol-%zu", i);
+        grim_intern(name, NULL);
+    }
+    gb_report(&timer, "intern (new)", n);
+
+    gb_start(&timer);
+    for (int r = 0; r < rounds; r++)
+        for (size_t i = 0; i < n; i++) {
+            snprintf(name, sizeof(name), "symbol-%zu", i);
+            grim_intern(name, NULL);
+        }
+    gb_report(&timer, "intern (existing)", n * rounds);
+
+    gb_start(&timer);
+    for (int r = 0; r < rounds; r++)
+        GC_gcollect();
+    gb_report(&timer, "full collection", rounds);
+
+    return 0;
+}
@@ -1,5 +1,6 @@
 #include <locale.h>
 #include <stdio.h>
+#include <stdlib.h>
 
 #include "grim.h"
 #include "internal.h"
@@ -22,8 +23,21 @@ int main(int argc, char **argv) {
     grim_object code = grim_read_file(file);
     fclose(file);
 
+    // GRIM_PROFILE=path profiles the module's allocations, writing a
+    // pprof file there and a summary to stderr
+    const char *profile = getenv("GRIM_PROFILE");
+    if (profile)
+        grim_profile_start();
+
     grim_object name = grim_intern("--main--", NULL);
     grim_object module = grim_build_module(name, code);
+
+    if (profile) {
+        grim_profile_stop();
+        grim_profile_report(stderr, module, 20);
+        if (!grim_profile_write_pprof(profile))
+            fprintf(stderr, "Unable to write %s\n", profile);
+    }
     grim_print(module, "UTF-8");
     printf("\n");
     grim_print(grim_module_get(module, grim_intern("a", NULL)), "UTF-8");
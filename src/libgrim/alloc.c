@@ -0,0 +1,512 @@
+#include <assert.h>
+#include <pthread.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "gc.h"
+#include "gc_inline.h"
+#include "gc_mark.h"
+#include "gc_typed.h"
+
+#include "grim.h"
+#include "internal.h"
+
+
+// Layouts
+// -----------------------------------------------------------------------------
+
+// Each layout other than the conservative, cons, atomic and immortal
+// ones has a type descriptor, marking the words that may hold pointers.
+// Everything else (tags, lengths, hashes) is skipped by the collector,
+// so it can't keep garbage alive by looking like an address.
+
+static GC_descr grim_layout_descrs[GRIM_NLAYOUTS];
+
+static GC_descr grim_make_descr(const size_t *offsets, size_t noffsets) {
+    GC_word bitmap[1] = {0};
+    size_t nwords = 0;
+    for (size_t i = 0; i < noffsets; i++) {
+        size_t word = offsets[i] / sizeof(GC_word);
+        GC_set_bit(bitmap, word);
+        if (word + 1 > nwords)
+            nwords = word + 1;
+    }
+    return GC_make_descriptor(bitmap, nwords);
+}
+
+#define GRIM_DESCR(...)                                                        \
+    grim_make_descr((const size_t[]) { __VA_ARGS__ },                          \
+                    sizeof((const size_t[]) { __VA_ARGS__ }) / sizeof(size_t))
+
+static void grim_layout_init() {
+    grim_layout_descrs[GRIM_LAYOUT_BOXED] = GRIM_DESCR(
+        offsetof(grim_ibuffer, cbuf));
+    grim_layout_descrs[GRIM_LAYOUT_BIGINT] = GRIM_DESCR(
+        offsetof(grim_ibigint, bigint[0]._mp_d));
+    grim_layout_descrs[GRIM_LAYOUT_RATIONAL] = GRIM_DESCR(
+        offsetof(grim_irational, rational[0]._mp_num._mp_d),
+        offsetof(grim_irational, rational[0]._mp_den._mp_d));
+    grim_layout_descrs[GRIM_LAYOUT_HASHTABLE] = GRIM_DESCR(
+        offsetof(grim_ihashtable, slots.ctrl),
+        offsetof(grim_ihashtable, slots.index),
+        offsetof(grim_ihashtable, slots.keys),
+        offsetof(grim_ihashtable, slots.values),
+        offsetof(grim_ihashtable, slots.hashes),
+        offsetof(grim_ihashtable, oldslots.ctrl),
+        offsetof(grim_ihashtable, oldslots.index),
+        offsetof(grim_ihashtable, oldslots.keys),
+        offsetof(grim_ihashtable, oldslots.values),
+        offsetof(grim_ihashtable, oldslots.hashes),
+        offsetof(grim_ihashtable, shards));
+}
+
+// All boxed objects keep their one pointer in the same place
+static_assert(offsetof(grim_istring, sbuf) == offsetof(grim_ibuffer, cbuf), "");
+static_assert(offsetof(grim_ivector, obuf) == offsetof(grim_ibuffer, cbuf), "");
+static_assert(offsetof(grim_inumvector, nbuf) == offsetof(grim_ibuffer, cbuf), "");
+
+
+// Small objects
+// -----------------------------------------------------------------------------
+
+// Objects of up to GRIM_SMALL_GRANULES granules are taken from
+// thread-local free lists, one per kind and size, which are refilled
+// in bulk with GC_generic_malloc_many.  Objects come out of the
+// collector linked through their first word, so allocation is a pop
+// from the front of the list.
+//
+// Indirect objects and conses get kinds of their own, separate from
+// the payloads they point to, so that the census below can tell them
+// apart without looking inside.  With interior pointers enabled, the
+// collector's normal kind skips the last word of every object,
+// expecting it to be the byte of slop that GC_MALLOC adds.  Since we
+// allocate exact granules, that word may be a live pointer (the cdr of
+// a cons, say), so our conservative kinds scan the whole object.  The
+// other kinds scan only what their descriptor says.  Payloads are
+// allocated with the collector's own kinds where possible, since there
+// are only GRIM_MAX_KINDS to go around.
+//
+// This means that the links in most free lists are invisible to the
+// collector.  The list heads live in uncollectable blocks, which are
+// chained together, and at every collection we mark the objects on
+// them by hand, as the collector does with its own free lists.  When a
+// thread exits, its block is taken off the chain and freed, and the
+// objects on its lists are reclaimed at the next collection.
+
+#define GRIM_MAX_KINDS (16)
+
+typedef struct grim_freelists_t {
+    void *lists[GRIM_MAX_KINDS][GRIM_SMALL_GRANULES + 1];
+    struct grim_freelists_t *next;
+} grim_freelists;
+
+static _Thread_local grim_freelists *grim_local_freelists;
+static grim_freelists *grim_all_freelists;
+static pthread_key_t grim_freelists_key;
+static int grim_object_kinds[GRIM_NLAYOUTS];
+static int grim_payload_kinds[GRIM_NLAYOUTS];
+static bool grim_is_object_kind[GRIM_MAX_KINDS];
+static GC_push_other_roots_proc grim_next_push_roots;
+static GC_on_collection_event_proc grim_next_gc_event;
+
+static void grim_freelists_apply(void (*proc)(const void *)) {
+    for (grim_freelists *fl = grim_all_freelists; fl; fl = fl->next)
+        for (int kind = 0; kind < GRIM_MAX_KINDS; kind++)
+            for (size_t g = 0; g <= GRIM_SMALL_GRANULES; g++)
+                for (void *obj = fl->lists[kind][g]; obj; obj = GC_NEXT(obj))
+                    proc(obj);
+}
+
+static void grim_push_freelists() {
+    grim_freelists_apply(GC_set_mark_bit);
+    if (grim_next_push_roots)
+        grim_next_push_roots();
+}
+
+static void *grim_register_freelists(void *freelists) {
+    ((grim_freelists *) freelists)->next = grim_all_freelists;
+    grim_all_freelists = freelists;
+    return NULL;
+}
+
+static void *grim_unregister_freelists(void *freelists) {
+    grim_freelists **link = &grim_all_freelists;
+    while (*link != freelists)
+        link = &(*link)->next;
+    *link = ((grim_freelists *) freelists)->next;
+    return NULL;
+}
+
+static void grim_release_freelists(void *freelists) {
+    GC_call_with_alloc_lock(grim_unregister_freelists, freelists);
+    GC_FREE(freelists);
+    grim_local_freelists = NULL;
+}
+
+static int grim_new_kind(GC_descr descr, bool adjust, bool clear) {
+    int kind = GC_new_kind(GC_new_free_list(), descr, adjust, clear);
+    assert(kind < GRIM_MAX_KINDS);
+    return kind;
+}
+
+static void grim_gc_event(GC_EventType event);
+
+void grim_alloc_init() {
+    // The collector can't take kinds back, and the hooks chain to
+    // whatever was there before them, so they're all set up once, and
+    // kept if grim_init is called again
+    static bool initialized = false;
+    if (initialized)
+        return;
+    initialized = true;
+
+    grim_layout_init();
+    for (int layout = 0; layout < GRIM_NLAYOUTS; layout++)
+        grim_object_kinds[layout] = grim_payload_kinds[layout] = -1;
+
+    grim_object_kinds[GRIM_LAYOUT_CONSERVATIVE] = grim_new_kind(GC_DS_LENGTH, true, true);
+    grim_object_kinds[GRIM_LAYOUT_CONS] = grim_new_kind(GC_DS_LENGTH, true, true);
+    grim_object_kinds[GRIM_LAYOUT_ATOMIC] = grim_new_kind(GC_DS_LENGTH, false, false);
+    for (int layout = GRIM_LAYOUT_BOXED; layout <= GRIM_LAYOUT_HASHTABLE; layout++)
+        grim_object_kinds[layout] = grim_new_kind(grim_layout_descrs[layout], false, true);
+    for (int layout = 0; layout < GRIM_NLAYOUTS; layout++)
+        if (grim_object_kinds[layout] >= 0)
+            grim_is_object_kind[grim_object_kinds[layout]] = true;
+
+    grim_payload_kinds[GRIM_LAYOUT_ATOMIC] = GC_I_PTRFREE;
+    pthread_key_create(&grim_freelists_key, grim_release_freelists);
+
+    grim_next_push_roots = GC_get_push_other_roots();
+    GC_set_push_other_roots(grim_push_freelists);
+    grim_next_gc_event = GC_get_on_collection_event();
+    GC_set_on_collection_event(grim_gc_event);
+}
+
+static void *grim_small_refill(size_t granules, int kind) {
+    if (!grim_local_freelists) {
+        grim_local_freelists = GC_MALLOC_UNCOLLECTABLE(sizeof(grim_freelists));
+        assert(grim_local_freelists);
+        GC_call_with_alloc_lock(grim_register_freelists, grim_local_freelists);
+        pthread_setspecific(grim_freelists_key, grim_local_freelists);
+    }
+
+    // Request exactly whole granules: unlike GC_MALLOC, this doesn't
+    // add a byte of slop, so a two-word object takes one granule
+    void **list = &grim_local_freelists->lists[kind][granules];
+    GC_generic_malloc_many(granules * GRIM_GRANULE_BYTES, kind, list);
+    void *retval = *list;
+    assert(retval);
+    *list = GC_NEXT(retval);
+    GC_NEXT(retval) = NULL;
+    return retval;
+}
+
+static inline void *grim_small_alloc(size_t size, int kind) {
+    size_t granules = (size + GRIM_GRANULE_BYTES - 1) / GRIM_GRANULE_BYTES;
+    grim_freelists *freelists = grim_local_freelists;
+    if (freelists) {
+        void *retval = freelists->lists[kind][granules];
+        if (retval) {
+            freelists->lists[kind][granules] = GC_NEXT(retval);
+            GC_NEXT(retval) = NULL;
+            return retval;
+        }
+    }
+    return grim_small_refill(granules, kind);
+}
+
+
+// Immortal objects
+// -----------------------------------------------------------------------------
+
+// Objects that live as long as the interpreter, and that don't point
+// into the collected heap (symbols and builtin functions), are packed
+// together into large atomic uncollectable chunks.  The collector
+// neither scans nor frees them.
+
+#define GRIM_IMMORTAL_CHUNK (64 * 1024)
+
+static char *grim_immortal_ptr;
+static char *grim_immortal_end;
+
+static void *grim_immortal_alloc(size_t size) {
+    size = (size + GRIM_GRANULE_BYTES - 1) & ~(size_t) (GRIM_GRANULE_BYTES - 1);
+    if ((size_t) (grim_immortal_end - grim_immortal_ptr) < size) {
+        size_t chunksize = size > GRIM_IMMORTAL_CHUNK ? size : GRIM_IMMORTAL_CHUNK;
+        grim_immortal_ptr = GC_MALLOC_ATOMIC_UNCOLLECTABLE(chunksize);
+        assert(grim_immortal_ptr);
+        grim_immortal_end = grim_immortal_ptr + chunksize;
+    }
+    void *retval = grim_immortal_ptr;
+    grim_immortal_ptr += size;
+    return retval;
+}
+
+
+// Allocation
+// -----------------------------------------------------------------------------
+
+void *grim_alloc(size_t size, grim_layout_t layout) {
+    assert(size > 0);
+    if (__builtin_expect(grim_profiling, false))
+        grim_profile_record(size, 2);
+    void *retval;
+    if (layout == GRIM_LAYOUT_IMMORTAL)
+        retval = grim_immortal_alloc(size);
+    else if (size <= GRIM_SMALL_GRANULES * GRIM_GRANULE_BYTES && grim_payload_kinds[layout] >= 0)
+        retval = grim_small_alloc(size, grim_payload_kinds[layout]);
+    else if (layout == GRIM_LAYOUT_CONSERVATIVE)
+        retval = GC_MALLOC(size);
+    else if (layout == GRIM_LAYOUT_ATOMIC)
+        retval = GC_MALLOC_ATOMIC(size);
+    else
+        retval = GC_MALLOC_EXPLICITLY_TYPED(size, grim_layout_descrs[layout]);
+    assert(retval);
+    return retval;
+}
+
+// Grows a payload.  Payloads of objects loaded from a heap image live
+// outside the collected heap, so those are copied into it instead.
+void *grim_realloc(void *ptr, size_t oldsize, size_t newsize, grim_layout_t layout) {
+    if (ptr && !GC_base(ptr)) {
+        void *retval = grim_alloc(newsize, layout);
+        memcpy(retval, ptr, oldsize < newsize ? oldsize : newsize);
+        return retval;
+    }
+    if (__builtin_expect(grim_profiling, false))
+        grim_profile_record(newsize, 2);
+    void *retval = GC_REALLOC(ptr, newsize);
+    assert(retval);
+    return retval;
+}
+
+grim_object grim_indirect_create(size_t size, grim_layout_t layout) {
+    assert(size > 0);
+    if (__builtin_expect(grim_profiling, false))
+        grim_profile_record(size, 2);
+    if (layout == GRIM_LAYOUT_IMMORTAL)
+        return (grim_object) grim_immortal_alloc(size);
+    int kind = grim_object_kinds[layout];
+    assert(kind >= 0);
+    void *retval;
+    if (size <= GRIM_SMALL_GRANULES * GRIM_GRANULE_BYTES)
+        retval = grim_small_alloc(size, kind);
+    else
+        retval = GC_generic_malloc(size, kind);
+    assert(retval);
+    return (grim_object) retval;
+}
+
+
+// Heap census
+// -----------------------------------------------------------------------------
+
+// Every live block of an object kind is an indirect object or a cons.
+// Their payloads are counted with them, by following their pointers,
+// and are otherwise skipped.  Immortal objects are never collected, so
+// they are simply counted as they are made.
+
+static grim_type_stats_t grim_immortal_stats[GRIM_NTYPES];
+
+static size_t grim_gc_count;
+static uint64_t grim_gc_start;
+static uint64_t grim_gc_pause_total;
+static uint64_t grim_gc_pause_max;
+
+static uint64_t grim_clock_ns() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t) ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+static void grim_gc_event(GC_EventType event) {
+    if (event == GC_EVENT_START)
+        grim_gc_start = grim_clock_ns();
+    else if (event == GC_EVENT_END) {
+        uint64_t pause = grim_clock_ns() - grim_gc_start;
+        grim_gc_count++;
+        grim_gc_pause_total += pause;
+        if (pause > grim_gc_pause_max)
+            grim_gc_pause_max = pause;
+    }
+    if (grim_next_gc_event)
+        grim_next_gc_event(event);
+}
+
+void grim_census_immortal(grim_type_t type, size_t size) {
+    grim_immortal_stats[type].count++;
+    grim_immortal_stats[type].bytes +=
+        (size + GRIM_GRANULE_BYTES - 1) & ~(size_t) (GRIM_GRANULE_BYTES - 1);
+}
+
+// Objects in heap images are counted by the image writer
+void grim_census_image(const grim_type_stats_t *types) {
+    for (int type = 0; type < GRIM_NTYPES; type++) {
+        grim_immortal_stats[type].count += types[type].count;
+        grim_immortal_stats[type].bytes += types[type].bytes;
+    }
+}
+
+// Size of a separately allocated payload, or zero if it isn't one (an
+// inline string, or limbs outside the collected heap)
+static size_t grim_payload_size(const void *ptr) {
+    return ptr && GC_base((void *) ptr) == ptr ? GC_size(ptr) : 0;
+}
+
+static size_t grim_limbs_size(const __mpz_struct *num) {
+    size_t size = grim_payload_size(num->_mp_d);
+    return size ? size : num->_mp_alloc * sizeof(mp_limb_t);
+}
+
+static void grim_census_block(void *block, size_t size, void *data) {
+    grim_heap_stats_t *stats = data;
+    int kind = GC_get_kind_and_size(block, NULL);
+    if (kind == grim_object_kinds[GRIM_LAYOUT_CONS]) {
+        stats->types[GRIM_CONS].count++;
+        stats->types[GRIM_CONS].bytes += size;
+        return;
+    }
+    if (kind >= GRIM_MAX_KINDS || !grim_is_object_kind[kind])
+        return;
+
+    grim_object obj = (grim_object) block;
+    switch (I_tag(obj)) {
+    case GRIM_BIGINT_TAG:
+        size += grim_limbs_size(I_bigint(obj));
+        break;
+    case GRIM_RATIONAL_TAG:
+        size += grim_limbs_size(mpq_numref(I_rational(obj)));
+        size += grim_limbs_size(mpq_denref(I_rational(obj)));
+        break;
+    case GRIM_STRING_TAG:
+        size += grim_payload_size(I_str(obj));
+        break;
+    case GRIM_VECTOR_TAG:
+        size += grim_payload_size(I_vectordata(obj));
+        break;
+    case GRIM_BUFFER_TAG:
+        size += grim_payload_size(I_buf(obj));
+        break;
+    case GRIM_F64VECTOR_TAG:
+    case GRIM_S64VECTOR_TAG:
+    case GRIM_BYTEVECTOR_TAG:
+        size += grim_payload_size(I_numdata(obj));
+        break;
+    case GRIM_HASHTABLE_TAG:
+    {
+        grim_hashslots *slots[] = {I_hashslots(obj), I_hasholdslots(obj)};
+        for (int i = 0; i < 2; i++) {
+            size += grim_payload_size(slots[i]->ctrl);
+            size += grim_payload_size(slots[i]->index);
+            size += grim_payload_size(slots[i]->keys);
+            size += grim_payload_size(slots[i]->values);
+            size += grim_payload_size(slots[i]->hashes);
+        }
+        size += grim_payload_size(I_hashshards(obj));
+        break;
+    }
+    case GRIM_FRAME_TAG:
+    {
+        // The stack is a vector of its own, which is also visited:
+        // move it over from the vectors to the frames.  The totals
+        // come out right in whichever order the two are seen.
+        grim_object stack = I_framestack(obj);
+        size_t stacksize = GC_size((void *) stack) + grim_payload_size(I_vectordata(stack));
+        stats->types[GRIM_VECTOR].count--;
+        stats->types[GRIM_VECTOR].bytes -= stacksize;
+        size += stacksize;
+        break;
+    }
+    }
+
+    grim_type_t type = grim_type(obj);
+    stats->types[type].count++;
+    stats->types[type].bytes += size;
+}
+
+static void *grim_census(void *stats) {
+    // Objects waiting on our free lists are marked, to keep the
+    // collector from handing them out again, but they aren't live
+    grim_freelists_apply(GC_clear_mark_bit);
+    GC_enumerate_reachable_objects_inner(grim_census_block, stats);
+    grim_freelists_apply(GC_set_mark_bit);
+    return NULL;
+}
+
+void grim_heap_stats(grim_heap_stats_t *stats) {
+    memset(stats, 0, sizeof(grim_heap_stats_t));
+    GC_gcollect();
+    GC_call_with_alloc_lock(grim_census, stats);
+    stats->gc_count = grim_gc_count;
+    stats->gc_pause_total = grim_gc_pause_total / 1e9;
+    stats->gc_pause_max = grim_gc_pause_max / 1e9;
+    for (int type = 0; type < GRIM_NTYPES; type++) {
+        stats->types[type].count += grim_immortal_stats[type].count;
+        stats->types[type].bytes += grim_immortal_stats[type].bytes;
+    }
+    stats->heap_bytes = GC_get_heap_size();
+    stats->free_bytes = GC_get_free_bytes();
+}
+
+
+// Scratch arenas
+// -----------------------------------------------------------------------------
+
+// Bump allocators for short-lived temporaries, such as the normalized
+// digits of a number being read.  Small requests are served from a
+// buffer inside the arena itself, so an arena on the stack normally
+// doesn't touch the heap at all.  Larger ones spill into malloc'd
+// chunks, each at least twice the size of the last.  Resetting keeps
+// only the largest chunk, so that an arena reset after every form of a
+// long file settles on a single buffer.
+
+void grim_arena_init(grim_arena *arena) {
+    arena->chunks = NULL;
+    arena->ptr = arena->inline_buf;
+    arena->end = arena->inline_buf + GRIM_ARENA_INLINE;
+}
+
+void *grim_arena_alloc(grim_arena *arena, size_t size) {
+    size = (size + GRIM_ALIGN - 1) & ~(size_t) (GRIM_ALIGN - 1);
+    if ((size_t) (arena->end - arena->ptr) < size) {
+        size_t chunksize = arena->chunks ? 2 * arena->chunks->size : 2 * GRIM_ARENA_INLINE;
+        while (chunksize < size)
+            chunksize *= 2;
+        grim_arena_chunk *chunk = malloc(sizeof(grim_arena_chunk) + chunksize);
+        assert(chunk);
+        chunk->next = arena->chunks;
+        chunk->size = chunksize;
+        arena->chunks = chunk;
+        arena->ptr = chunk->data;
+        arena->end = chunk->data + chunksize;
+    }
+    void *retval = arena->ptr;
+    arena->ptr += size;
+    return retval;
+}
+
+void grim_arena_reset(grim_arena *arena) {
+    grim_arena_chunk *chunk = arena->chunks;
+    if (!chunk) {
+        arena->ptr = arena->inline_buf;
+        return;
+    }
+    while (chunk->next) {
+        grim_arena_chunk *next = chunk->next->next;
+        free(chunk->next);
+        chunk->next = next;
+    }
+    arena->ptr = chunk->data;
+    arena->end = chunk->data + chunk->size;
+}
+
+void grim_arena_free(grim_arena *arena) {
+    while (arena->chunks) {
+        grim_arena_chunk *next = arena->chunks->next;
+        free(arena->chunks);
+        arena->chunks = next;
+    }
+}
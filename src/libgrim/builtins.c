@@ -24,3 +24,141 @@ grim_object gf_sub(int nargs, const grim_object *args) {
         sum = grim_add(sum, args[i], true);
     return sum;
 }
+
+static size_t gf_index(int nargs, const grim_object *args, int i, size_t def) {
+    if (i >= nargs)
+        return def;
+    assert(grim_integer_extractable(args[i]) && grim_nonnegative(args[i]));
+    return grim_integer_extract(args[i]);
+}
+
+// (vector-copy! to at from [start [end]])
+grim_object gf_vector_copy(int nargs, const grim_object *args) {
+    assert(nargs <= 5);
+    grim_object dest = args[0], src = args[2];
+    assert(grim_type(dest) == GRIM_VECTOR && grim_type(src) == GRIM_VECTOR);
+    size_t at = gf_index(nargs, args, 1, 0);
+    size_t start = gf_index(nargs, args, 3, 0);
+    size_t end = gf_index(nargs, args, 4, I_vectorlen(src));
+    grim_vector_copy(dest, at, src, start, end);
+    return grim_undefined;
+}
+
+// (vector-fill! vec fill [start [end]])
+grim_object gf_vector_fill(int nargs, const grim_object *args) {
+    assert(nargs <= 4);
+    grim_object vec = args[0];
+    assert(grim_type(vec) == GRIM_VECTOR);
+    size_t start = gf_index(nargs, args, 2, 0);
+    size_t end = gf_index(nargs, args, 3, I_vectorlen(vec));
+    grim_vector_fill(vec, args[1], start, end);
+    return grim_undefined;
+}
+
+grim_object gf_numvector_add(int nargs, const grim_object *args) {
+    (void) nargs;
+    return grim_numvector_add(args[0], args[1]);
+}
+
+grim_object gf_numvector_mul(int nargs, const grim_object *args) {
+    (void) nargs;
+    return grim_numvector_mul(args[0], args[1]);
+}
+
+grim_object gf_numvector_sum(int nargs, const grim_object *args) {
+    (void) nargs;
+    return grim_numvector_sum(args[0]);
+}
+
+grim_object gf_numvector_dot(int nargs, const grim_object *args) {
+    (void) nargs;
+    return grim_numvector_dot(args[0], args[1]);
+}
+
+grim_object gf_numvector_min(int nargs, const grim_object *args) {
+    (void) nargs;
+    return grim_numvector_min(args[0]);
+}
+
+grim_object gf_numvector_max(int nargs, const grim_object *args) {
+    (void) nargs;
+    return grim_numvector_max(args[0]);
+}
+
+// (hashtable-for-each proc table), calling (proc key value) for each
+// entry in the order they were added.  proc must not change the table.
+grim_object gf_hashtable_for_each(int nargs, const grim_object *args) {
+    (void) nargs;
+    grim_object func = args[0], table = args[1];
+    assert(grim_type(table) == GRIM_HASHTABLE);
+    grim_object key, value;
+    for (size_t pos = 0; grim_hashtable_next(table, &pos, &key, &value);)
+        grim_call_2(func, key, value);
+    return grim_undefined;
+}
+
+// (hashtable-map proc table), making a new table with the same keys,
+// in the same order, and the values (proc key value)
+grim_object gf_hashtable_map(int nargs, const grim_object *args) {
+    (void) nargs;
+    grim_object func = args[0], table = args[1];
+    assert(grim_type(table) == GRIM_HASHTABLE);
+    grim_object result = grim_hashtable_create(I_hashshards(table) ? 0 : I_hashfill(table));
+    grim_object key, value;
+    for (size_t pos = 0; grim_hashtable_next(table, &pos, &key, &value);)
+        grim_hashtable_set(result, key, grim_call_2(func, key, value));
+    return result;
+}
+
+static const char *gf_type_names[GRIM_NTYPES] = {
+    [GRIM_INTEGER] = "integer",
+    [GRIM_CHARACTER] = "character",
+    [GRIM_SYMBOL] = "symbol",
+    [GRIM_UNDEFINED] = "undefined",
+    [GRIM_BOOLEAN] = "boolean",
+    [GRIM_NIL] = "nil",
+    [GRIM_FLOAT] = "float",
+    [GRIM_RATIONAL] = "rational",
+    [GRIM_COMPLEX] = "complex",
+    [GRIM_STRING] = "string",
+    [GRIM_VECTOR] = "vector",
+    [GRIM_CONS] = "cons",
+    [GRIM_BUFFER] = "buffer",
+    [GRIM_HASHTABLE] = "hashtable",
+    [GRIM_CELL] = "cell",
+    [GRIM_MODULE] = "module",
+    [GRIM_FUNCTION] = "function",
+    [GRIM_FRAME] = "frame",
+    [GRIM_F64VECTOR] = "f64vector",
+    [GRIM_S64VECTOR] = "s64vector",
+    [GRIM_BYTEVECTOR] = "bytevector",
+};
+
+static grim_object gf_stat(const char *name, grim_object value, grim_object rest) {
+    return grim_cons_pack(grim_cons_pack(grim_intern(name, NULL), value), rest);
+}
+
+// Returns an association list: (type count bytes) for each type with
+// live objects, followed by (name . value) pairs for the whole heap
+grim_object gf_heap_stats(int nargs, const grim_object *args) {
+    (void) nargs;
+    (void) args;
+
+    grim_heap_stats_t stats;
+    grim_heap_stats(&stats);
+
+    grim_object result = grim_nil;
+    result = gf_stat("gc-pause-max", grim_float_pack(stats.gc_pause_max), result);
+    result = gf_stat("gc-pause-total", grim_float_pack(stats.gc_pause_total), result);
+    result = gf_stat("gc-count", grim_integer_pack(stats.gc_count), result);
+    result = gf_stat("free-bytes", grim_integer_pack(stats.free_bytes), result);
+    result = gf_stat("heap-bytes", grim_integer_pack(stats.heap_bytes), result);
+    for (int type = GRIM_NTYPES - 1; type >= 0; type--) {
+        if (!stats.types[type].count)
+            continue;
+        grim_object entry = grim_cons_pack(grim_integer_pack(stats.types[type].bytes), grim_nil);
+        entry = grim_cons_pack(grim_integer_pack(stats.types[type].count), entry);
+        result = gf_stat(gf_type_names[type], entry, result);
+    }
+    return result;
+}
@@ -1,6 +1,7 @@
 #define _GNU_SOURCE
 
 #include <assert.h>
+#include <inttypes.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -16,12 +17,51 @@ typedef void printfunc(grim_object buf, grim_object src, const char *encoding);
 
 
 static void grim_encode_mpz(grim_object buf, mpz_t num) {
+    // The string comes from GMP's allocator, which may not be malloc
+    void (*freefunc)(void *, size_t);
+    mp_get_memory_functions(NULL, NULL, &freefunc);
+
     char *z = NULL;
     int len = gmp_asprintf(&z, "%Zd", num);
     grim_buffer_copy(buf, z, len);
+    freefunc(z, len + 1);
+}
+
+static void grim_encode_float(grim_object buf, double num) {
+    char *z = NULL;
+    int len = asprintf(&z, "%f", num);
+    grim_buffer_copy(buf, z, len);
     free(z);
 }
 
+static void grim_encode_numvector(grim_object buf, grim_object src) {
+    switch (I_tag(src)) {
+    case GRIM_F64VECTOR_TAG: grim_buffer_copy(buf, "#f64(", 5); break;
+    case GRIM_S64VECTOR_TAG: grim_buffer_copy(buf, "#s64(", 5); break;
+    case GRIM_BYTEVECTOR_TAG: grim_buffer_copy(buf, "#u8(", 4); break;
+    }
+    size_t len = I_numlen(src);
+    for (size_t i = 0; i < len; i++) {
+        if (i > 0)
+            grim_buffer_copy(buf, " ", 1);
+        char z[32];
+        int zlen = 0;
+        switch (I_tag(src)) {
+        case GRIM_F64VECTOR_TAG:
+            grim_encode_float(buf, I_f64data(src)[i]);
+            break;
+        case GRIM_S64VECTOR_TAG:
+            zlen = snprintf(z, sizeof(z), "%" PRId64, I_s64data(src)[i]);
+            break;
+        case GRIM_BYTEVECTOR_TAG:
+            zlen = snprintf(z, sizeof(z), "%u", I_u8data(src)[i]);
+            break;
+        }
+        grim_buffer_copy(buf, z, zlen);
+    }
+    grim_buffer_copy(buf, ")", 1);
+}
+
 static void grim_encode_simple(grim_object buf, grim_object src, const char *encoding) {
     (void) encoding;
 
@@ -46,16 +86,14 @@ static void grim_encode_simple(grim_object buf, grim_object src, const char *enc
     case GRIM_SYMBOL_TAG:
         grim_display_string(buf, I_symbolname(src), encoding);
         return;
+    case GRIM_FLONUM_TAG:
+        grim_encode_float(buf, grim_float_extract(src));
+        return;
     case GRIM_INDIRECT_TAG:
         switch (I_tag(src)) {
         case GRIM_FLOAT_TAG:
-        {
-            char *z = NULL;
-            int len = asprintf(&z, "%f", I_floating(src));
-            grim_buffer_copy(buf, z, len);
-            free(z);
+            grim_encode_float(buf, I_floating(src));
             return;
-        }
         case GRIM_BIGINT_TAG:
             grim_encode_mpz(buf, I_bigint(src));
             return;
@@ -71,6 +109,11 @@ static void grim_encode_simple(grim_object buf, grim_object src, const char *enc
             grim_encode_simple(buf, I_imag(src), encoding);
             grim_buffer_copy(buf, "i", 1);
             return;
+        case GRIM_F64VECTOR_TAG:
+        case GRIM_S64VECTOR_TAG:
+        case GRIM_BYTEVECTOR_TAG:
+            grim_encode_numvector(buf, src);
+            return;
         case GRIM_BUFFER_TAG:
             grim_buffer_copy(buf, "#<buffer>", 9);
             return;
@@ -134,6 +177,9 @@ void grim_encode_display(grim_object buf, grim_object src, const char *encoding)
     case GRIM_CHARACTER_TAG:
         grim_display_character(buf, src, encoding);
         return;
+    case GRIM_CONS_TAG:
+        grim_encode_cons(buf, src, encoding, grim_encode_display);
+        return;
     case GRIM_INDIRECT_TAG:
         switch (I_tag(src)) {
         case GRIM_STRING_TAG:
@@ -142,9 +188,6 @@ void grim_encode_display(grim_object buf, grim_object src, const char *encoding)
         case GRIM_VECTOR_TAG:
             grim_encode_vector(buf, src, encoding, grim_encode_display);
             return;
-        case GRIM_CONS_TAG:
-            grim_encode_cons(buf, src, encoding, grim_encode_display);
-            return;
         }
     }
     grim_encode_simple(buf, src, encoding);
@@ -156,6 +199,9 @@ void grim_encode_print(grim_object buf, grim_object src, const char *encoding) {
     case GRIM_CHARACTER_TAG:
         grim_print_character(buf, src, encoding);
         return;
+    case GRIM_CONS_TAG:
+        grim_encode_cons(buf, src, encoding, grim_encode_print);
+        return;
     case GRIM_INDIRECT_TAG:
         switch (I_tag(src)) {
         case GRIM_STRING_TAG:
@@ -164,9 +210,6 @@ void grim_encode_print(grim_object buf, grim_object src, const char *encoding) {
         case GRIM_VECTOR_TAG:
             grim_encode_vector(buf, src, encoding, grim_encode_print);
             return;
-        case GRIM_CONS_TAG:
-            grim_encode_cons(buf, src, encoding, grim_encode_print);
-            return;
         }
     }
 
@@ -188,22 +231,166 @@ void grim_print(grim_object obj, const char *encoding) {
 }
 
 
-bool grim_equal(grim_object a, grim_object b) {
-    if (grim_direct_tag(a) != GRIM_INDIRECT_TAG &&
+// Conses, vectors and complex numbers are equal if what they hold is.
+// Pairs of them still to be compared are kept on a stack, rather than
+// recursed into, so that deep structures can't overflow the C stack.
+// Once GRIM_EQUAL_BUDGET pairs have been gone through, each pair is
+// remembered, and taken to be equal if it turns up again, since any
+// difference between them is found the first time round.  That is
+// what stops comparisons of cyclic structures.
+#define GRIM_EQUAL_BUDGET (1024)
+#define GRIM_EQUAL_STACK (32)
+
+typedef struct {
+    grim_object *stack;
+    size_t depth;
+    size_t cap;
+    size_t steps;
+    grim_object *seen;
+    size_t seencap;
+    size_t seenfill;
+} grim_equal_walk;
+
+static inline bool grim_equal_compound(grim_object obj) {
+    if ((obj & 0x0f) == GRIM_CONS_TAG)
+        return true;
+    return (obj & 0x0f) == GRIM_INDIRECT_TAG && (I_tag(obj) == GRIM_VECTOR_TAG || I_tag(obj) == GRIM_COMPLEX_TAG);
+}
+
+static void grim_equal_push(grim_equal_walk *w, grim_object a, grim_object b) {
+    if (w->depth == w->cap) {
+        grim_object *stack = malloc(4 * w->cap * sizeof(grim_object));
+        assert(stack);
+        memcpy(stack, w->stack, 2 * w->depth * sizeof(grim_object));
+        if (w->cap > GRIM_EQUAL_STACK)
+            free(w->stack);
+        w->stack = stack;
+        w->cap *= 2;
+    }
+    w->stack[2 * w->depth] = a;
+    w->stack[2 * w->depth + 1] = b;
+    w->depth++;
+}
+
+static grim_object *grim_equal_slot(grim_object *seen, size_t cap, grim_object a, grim_object b) {
+    size_t i = (a * 0x9e3779b97f4a7c15 ^ b) * 0xff51afd7ed558ccd >> 32;
+    for (i &= cap - 1; seen[2 * i] && (seen[2 * i] != a || seen[2 * i + 1] != b); i = (i + 1) & (cap - 1));
+    return &seen[2 * i];
+}
+
+// Remembers a pair, and tells whether it was already known
+static bool grim_equal_seen(grim_equal_walk *w, grim_object a, grim_object b) {
+    if (2 * (w->seenfill + 1) > w->seencap) {
+        size_t newcap = w->seencap ? 2 * w->seencap : 2 * GRIM_EQUAL_BUDGET;
+        grim_object *newseen = calloc(2 * newcap, sizeof(grim_object));
+        assert(newseen);
+        for (size_t i = 0; i < w->seencap; i++)
+            if (w->seen[2 * i])
+                memcpy(grim_equal_slot(newseen, newcap, w->seen[2 * i], w->seen[2 * i + 1]),
+                       &w->seen[2 * i], 2 * sizeof(grim_object));
+        free(w->seen);
+        w->seen = newseen;
+        w->seencap = newcap;
+    }
+    grim_object *slot = grim_equal_slot(w->seen, w->seencap, a, b);
+    if (slot[0])
+        return true;
+    slot[0] = a;
+    slot[1] = b;
+    w->seenfill++;
+    return false;
+}
+
+// Compares two objects that aren't the same and hold no others
+static inline bool grim_equal_atoms(grim_object a, grim_object b) {
+    if (grim_direct_tag(a) != GRIM_INDIRECT_TAG ||
         grim_direct_tag(b) != GRIM_INDIRECT_TAG)
-        return a == b;
+        return false;
     if (I_tag(a) != I_tag(b))
         return false;
     switch (I_tag(a)) {
+    case GRIM_FLOAT_TAG:
+        // Compare bit patterns, so that NaNs are equal to themselves
+        return !memcmp(&I_floating(a), &I_floating(b), sizeof(double));
     case GRIM_BIGINT_TAG:
         return !mpz_cmp(I_bigint(a), I_bigint(b));
+    case GRIM_RATIONAL_TAG:
+        return mpq_equal(I_rational(a), I_rational(b));
     case GRIM_STRING_TAG:
-        if (I_strlen(a) != I_strlen(b))
+        // Strings whose hashes are known are told apart without
+        // looking at them
+        if (I_strlen(a) != I_strlen(b) || (I_strhash(a) && I_strhash(b) && I_strhash(a) != I_strhash(b)))
             return false;
         return !memcmp(I_str(a), I_str(b), I_strlen(a));
+    case GRIM_F64VECTOR_TAG:
+    case GRIM_S64VECTOR_TAG:
+    case GRIM_BYTEVECTOR_TAG:
+        // Like floats, elements are compared by bit pattern
+        if (I_numlen(a) != I_numlen(b))
+            return false;
+        return !memcmp(I_numdata(a), I_numdata(b), I_numlen(a) * grim_numvector_eltsize(I_tag(a)));
+    }
+
+    return false;
+}
+
+static bool grim_equal_visit(grim_equal_walk *w, grim_object a, grim_object b);
+
+// Compares two conses, vectors or complex numbers that aren't the
+// same, leaving what they hold to grim_equal_visit
+static bool grim_equal_step(grim_equal_walk *w, grim_object a, grim_object b) {
+    if ((a & 0x0f) == GRIM_CONS_TAG) {
+        if ((b & 0x0f) != GRIM_CONS_TAG)
+            return false;
+        if (w->steps++ >= GRIM_EQUAL_BUDGET && grim_equal_seen(w, a, b))
+            return true;
+        return grim_equal_visit(w, I_cdr(a), I_cdr(b)) && grim_equal_visit(w, I_car(a), I_car(b));
     }
+    if ((b & 0x0f) != GRIM_INDIRECT_TAG || I_tag(a) != I_tag(b))
+        return false;
+    if (I_tag(a) == GRIM_COMPLEX_TAG)
+        return grim_equal_visit(w, I_imag(a), I_imag(b)) && grim_equal_visit(w, I_real(a), I_real(b));
+
+    if (I_vectorlen(a) != I_vectorlen(b))
+        return false;
+    if (w->steps++ >= GRIM_EQUAL_BUDGET && grim_equal_seen(w, a, b))
+        return true;
+    for (size_t i = I_vectorlen(a); i > 0; i--)
+        if (!grim_equal_visit(w, I_vectorelt(a, i - 1), I_vectorelt(b, i - 1)))
+            return false;
+    return true;
+}
 
-    return a == b;
+// Compares two objects, or leaves them on the stack for later if they
+// hold others.  Cdrs are pushed before cars, so the stack doesn't grow
+// with the length of lists.
+static bool grim_equal_visit(grim_equal_walk *w, grim_object a, grim_object b) {
+    if (a == b)
+        return true;
+    if (grim_equal_compound(a)) {
+        grim_equal_push(w, a, b);
+        return true;
+    }
+    return grim_equal_atoms(a, b);
+}
+
+bool grim_equal(grim_object a, grim_object b) {
+    if (a == b)
+        return true;
+    if (!grim_equal_compound(a))
+        return grim_equal_atoms(a, b);
+
+    grim_object local[2 * GRIM_EQUAL_STACK];
+    grim_equal_walk w = {local, 0, GRIM_EQUAL_STACK, 0, NULL, 0, 0};
+    bool equal = grim_equal_step(&w, a, b);
+    while (equal && w.depth) {
+        w.depth--;
+        equal = grim_equal_step(&w, w.stack[2 * w.depth], w.stack[2 * w.depth + 1]);
+    }
+    if (w.cap > GRIM_EQUAL_STACK)
+        free(w.stack);
+    free(w.seen);
+    return equal;
 }
 
 
@@ -216,7 +403,5 @@ grim_object grim_read_file(FILE *file) {
         I_buflen(buf) += nread;
     }
 
-    // Slightly hacky, but buffers and strings are identical in memory
-    I_tag(buf) = GRIM_STRING_TAG;
-    return buf;
+    return grim_nstring_pack(I_buf(buf), I_buflen(buf), NULL, false);
 }
@@ -34,16 +34,28 @@ static void grim_init_builtins() {
     grim_builtin_module = grim_module_create(grim_intern("--builtins--", NULL));
     BUILTIN("+", add, 0, true);
     BUILTIN("-", sub, 0, true);
+    BUILTIN("vector-copy!", vector_copy, 3, true);
+    BUILTIN("vector-fill!", vector_fill, 2, true);
+    BUILTIN("numvector-add", numvector_add, 2, false);
+    BUILTIN("numvector-mul", numvector_mul, 2, false);
+    BUILTIN("numvector-sum", numvector_sum, 1, false);
+    BUILTIN("numvector-dot", numvector_dot, 2, false);
+    BUILTIN("numvector-min", numvector_min, 1, false);
+    BUILTIN("numvector-max", numvector_max, 1, false);
+    BUILTIN("hashtable-for-each", hashtable_for_each, 2, false);
+    BUILTIN("hashtable-map", hashtable_map, 2, false);
+    BUILTIN("heap-stats", heap_stats, 0, false);
 }
 
-void grim_init() {
+// Everything but the symbols and the builtins
+static void grim_init_core() {
     assert(GRIM_ALIGN >= 16);
 
-    grim_symbol_table = grim_hashtable_create(0);
-    grim_top_frame = grim_undefined;
-    gs_i_moduleset = grim_intern("%module-set!", NULL);
+    GC_INIT();
+    grim_alloc_init();
+    grim_gmp_init();
 
-    grim_init_builtins();
+    grim_top_frame = grim_undefined;
 
     grim_fixnum_max_ndigits[2] = sizeof(intmax_t) * CHAR_BIT - 1;
     grim_fixnum_max_ndigits[8] = ceil((sizeof(intmax_t) * CHAR_BIT - 1) / 3.0) - 1;
@@ -51,6 +63,26 @@ void grim_init() {
 
     snprintf(buf, NBUF, "%ju", GRIM_FIXNUM_MAX);
     grim_fixnum_max_ndigits[10] = strlen(buf) - 1;
+}
 
-    GC_INIT();
+void grim_init() {
+    grim_init_core();
+    grim_symbols_init();
+    grim_init_builtins();
+    gs_i_moduleset = grim_intern("%module-set!", NULL);
+}
+
+// Initializes the interpreter from a heap image instead, taking its
+// symbols and builtins from there.  Returns the image's root object,
+// or, if the image can't be loaded, initializes the interpreter from
+// scratch and returns undefined.
+grim_object grim_init_image(const char *path) {
+    grim_init_core();
+    grim_object root = grim_image_open(path, true);
+    if (root == grim_undefined) {
+        grim_symbols_init();
+        grim_init_builtins();
+    }
+    gs_i_moduleset = grim_intern("%module-set!", NULL);
+    return root;
 }
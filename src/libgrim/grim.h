@@ -33,18 +33,52 @@ typedef enum {
     GRIM_MODULE,
     GRIM_FUNCTION,
     GRIM_FRAME,
+    GRIM_F64VECTOR,
+    GRIM_S64VECTOR,
+    GRIM_BYTEVECTOR,
+    GRIM_NTYPES,
 } grim_type_t;
 
 grim_type_t grim_type(grim_object obj);
 
+typedef struct {
+    size_t count;
+    size_t bytes;
+} grim_type_stats_t;
+
+// Live objects per type, as of a full collection.  Bytes include
+// out-of-line payloads (string contents, vector and hashtable storage,
+// limbs, frame stacks).  Collection counts and pause times are for the
+// lifetime of the process, including the census' own collection.
+typedef struct {
+    grim_type_stats_t types[GRIM_NTYPES];
+    size_t heap_bytes;
+    size_t free_bytes;
+    size_t gc_count;
+    double gc_pause_total;
+    double gc_pause_max;
+} grim_heap_stats_t;
+
+void grim_heap_stats(grim_heap_stats_t *stats);
+
+// Allocation profiling.  Between start and stop, every allocation is
+// counted under the C call stack and the Grim function that made it.
+// Starting again discards the previous profile.
+void grim_profile_start();
+void grim_profile_stop();
+void grim_profile_report(FILE *stream, grim_object module, size_t nsites);
+bool grim_profile_write_pprof(const char *path);
+
 grim_object grim_float_pack(double num);
-double I_floating(grim_object obj);
+double grim_float_extract(grim_object obj);
 grim_object grim_float_read(const char *str);
+grim_object grim_nfloat_read(const char *str, size_t len);
 
 bool grim_integer_extractable(grim_object obj);
 intmax_t grim_integer_extract(grim_object obj);
 grim_object grim_integer_pack(intmax_t num);
 grim_object grim_integer_read(const char *str, int base);
+grim_object grim_ninteger_read(const char *str, size_t len, int base);
 
 grim_object grim_rational_pack(grim_object numerator, grim_object denominator);
 grim_object grim_rational_num(grim_object obj);
@@ -57,6 +91,20 @@ grim_object grim_nstring_pack(const char *input, size_t length, const char *enco
 size_t grim_strlen(grim_object obj);
 
 grim_object grim_vector_create(size_t nelems);
+void grim_vector_reserve(grim_object vec, size_t capacity);
+void grim_vector_push(grim_object vec, grim_object elt);
+void grim_vector_copy(grim_object dest, size_t at, grim_object src, size_t start, size_t end);
+void grim_vector_fill(grim_object vec, grim_object value, size_t start, size_t end);
+
+grim_object grim_f64vector_create(size_t nelems);
+grim_object grim_s64vector_create(size_t nelems);
+grim_object grim_bytevector_create(size_t nelems);
+grim_object grim_numvector_add(grim_object a, grim_object b);
+grim_object grim_numvector_mul(grim_object a, grim_object b);
+grim_object grim_numvector_sum(grim_object vec);
+grim_object grim_numvector_dot(grim_object a, grim_object b);
+grim_object grim_numvector_min(grim_object vec);
+grim_object grim_numvector_max(grim_object vec);
 
 grim_object grim_cons_pack(grim_object car, grim_object cdr);
 
@@ -70,12 +118,34 @@ ucs4_t grim_character_extract(grim_object obj);
 
 grim_object grim_buffer_create(size_t sizehint);
 
+// Weak tables drop entries once their keys, their values, or either,
+// are no longer referenced from anywhere else
+typedef enum {
+    GRIM_STRONG,
+    GRIM_WEAK_KEYS,
+    GRIM_WEAK_VALUES,
+    GRIM_WEAK_BOTH,
+} grim_weakness_t;
+
 grim_object grim_hashtable_create(size_t sizehint);
+grim_object grim_hashtable_create_weak(size_t sizehint, grim_weakness_t weakness);
+
+// Concurrent tables may be read and changed from several threads at
+// once, which nothing else in Grim may.  This needs the collector to
+// be built with thread support (GRIM_THREADS), so that it knows about
+// all the threads.
+grim_object grim_hashtable_create_concurrent(size_t sizehint);
 bool grim_hashtable_has(grim_object table, grim_object key);
 grim_object grim_hashtable_get(grim_object table, grim_object key);
 void grim_hashtable_set(grim_object table, grim_object key, grim_object value);
 void grim_hashtable_unset(grim_object table, grim_object key);
 
+// Steps through the entries of a table in the order they were added,
+// starting with *pos at zero, until it returns false.  The table must
+// not change meanwhile.  Concurrent tables are gone through in that
+// order one shard at a time.
+bool grim_hashtable_next(grim_object table, size_t *pos, grim_object *key, grim_object *value);
+
 grim_object grim_cell_pack(grim_object value);
 
 grim_object grim_module_create(grim_object name);
@@ -84,7 +154,15 @@ void grim_module_set(grim_object module, grim_object name, grim_object value);
 
 grim_object grim_cfunc_create(grim_cfunc *cfunc, uint8_t nargs, bool variadic);
 
+// Built with GRIM_GMP_GC, grim_init makes the collector GMP's allocator
+// for the whole process.  Numbers GMP allocated before then would be
+// freed into the collector, and ones the embedder keeps where the
+// collector doesn't look would be collected from under it, so such a
+// build is only for programs that leave GMP to Grim.
 void grim_init();
+grim_object grim_init_image(const char *path);
+bool grim_image_save(const char *path, grim_object root);
+grim_object grim_image_load(const char *path);
 void grim_display(grim_object obj, const char *encoding);
 void grim_print(grim_object obj, const char *encoding);
 bool grim_equal(grim_object a, grim_object b);
@@ -1,4 +1,5 @@
 #include <assert.h>
+#include <string.h>
 
 #include "murmur.h"
 #include "gmp.h"
@@ -6,14 +7,118 @@
 #include "grim.h"
 #include "internal.h"
 
-#define MURMUR_SEED 0xcafe8881
 
-static uint64_t hash_buffer(const char *buf, size_t len, uint64_t h) {
+// Hashing bytes
+// -----------------------------------------------------------------------------
+
+// Strings, bignums, floats and vectors of numbers are hashed by their
+// bytes, with wyhash (final version 4) unless libgrim is built to use
+// MurmurHash3 instead.  Wyhash folds eight bytes at a time with a
+// 64x64 to 128-bit multiply, and keys of up to sixteen bytes, which is
+// most of them, take a single multiply after a few overlapping loads.
+// Hashes are saved in images, so which of them is in use is part of
+// the image fingerprint.
+
+#ifdef GRIM_HASH_MURMUR
+
+uint64_t grim_hash_bytes(const char *buf, size_t len, uint64_t h) {
     uint64_t out[2];
     MurmurHash3_x86_128(buf, len, (uint32_t) h, out);
     return out[1] + h;
 }
 
+#else
+
+static const uint64_t wyhash_secret[4] = {
+    0x2d358dccaa6c78a5, 0x8bb84b93962eacc9, 0x4b33a62ed433d4a3, 0x4d5a2da51de1aa47,
+};
+
+static inline void wyhash_mum(uint64_t *a, uint64_t *b) {
+#ifdef __SIZEOF_INT128__
+    __uint128_t r = (__uint128_t) *a * *b;
+    *a = (uint64_t) r;
+    *b = (uint64_t) (r >> 64);
+#else
+    uint64_t ha = *a >> 32, hb = *b >> 32, la = (uint32_t) *a, lb = (uint32_t) *b;
+    uint64_t rh = ha * hb, rm0 = ha * lb, rm1 = hb * la, rl = la * lb;
+    uint64_t t = rl + (rm0 << 32), c = t < rl, lo = t + (rm1 << 32);
+    c += lo < t;
+    *a = lo;
+    *b = rh + (rm0 >> 32) + (rm1 >> 32) + c;
+#endif
+}
+
+static inline uint64_t wyhash_mix(uint64_t a, uint64_t b) {
+    wyhash_mum(&a, &b);
+    return a ^ b;
+}
+
+static inline uint64_t wyhash_read8(const uint8_t *p) {
+    uint64_t v;
+    memcpy(&v, p, 8);
+    return v;
+}
+
+static inline uint64_t wyhash_read4(const uint8_t *p) {
+    uint32_t v;
+    memcpy(&v, p, 4);
+    return v;
+}
+
+uint64_t grim_hash_bytes(const char *buf, size_t len, uint64_t h) {
+    const uint8_t *p = (const uint8_t *) buf;
+    uint64_t seed = h ^ wyhash_mix(h ^ wyhash_secret[0], wyhash_secret[1]);
+    uint64_t a, b;
+
+    if (__builtin_expect(len <= 16, 1)) {
+        // Two or four loads, which overlap unless len is 8 or 16
+        if (len >= 4) {
+            size_t mid = (len >> 3) << 2;
+            a = (wyhash_read4(p) << 32) | wyhash_read4(p + mid);
+            b = (wyhash_read4(p + len - 4) << 32) | wyhash_read4(p + len - 4 - mid);
+        }
+        else if (len > 0) {
+            a = ((uint64_t) p[0] << 16) | ((uint64_t) p[len >> 1] << 8) | p[len - 1];
+            b = 0;
+        }
+        else
+            a = b = 0;
+    }
+    else {
+        size_t i = len;
+        if (i >= 48) {
+            uint64_t seed1 = seed, seed2 = seed;
+            do {
+                seed = wyhash_mix(wyhash_read8(p) ^ wyhash_secret[1], wyhash_read8(p + 8) ^ seed);
+                seed1 = wyhash_mix(wyhash_read8(p + 16) ^ wyhash_secret[2], wyhash_read8(p + 24) ^ seed1);
+                seed2 = wyhash_mix(wyhash_read8(p + 32) ^ wyhash_secret[3], wyhash_read8(p + 40) ^ seed2);
+                p += 48;
+                i -= 48;
+            } while (i >= 48);
+            seed ^= seed1 ^ seed2;
+        }
+        while (i > 16) {
+            seed = wyhash_mix(wyhash_read8(p) ^ wyhash_secret[1], wyhash_read8(p + 8) ^ seed);
+            p += 16;
+            i -= 16;
+        }
+        // The last sixteen bytes, which may overlap what came before
+        a = wyhash_read8(p + i - 16);
+        b = wyhash_read8(p + i - 8);
+    }
+
+    a ^= wyhash_secret[1];
+    b ^= seed;
+    wyhash_mum(&a, &b);
+    return wyhash_mix(a ^ wyhash_secret[0] ^ len, b ^ wyhash_secret[1]);
+}
+
+#endif
+
+
+// Hashing objects
+// -----------------------------------------------------------------------------
+
 static uint64_t hash_uint64(uint64_t n) {
     n = ~n + (n << 21);
     n = n ^ (n >> 24);
@@ -25,34 +130,106 @@ static uint64_t hash_uint64(uint64_t n) {
     return n;
 }
 
+// Strings keep 32 bits of the hash of their contents, which is as good
+// as the whole of it at telling them apart, and spread it back over 64
+// bits when they're hashed.  It's the same hash as their symbol's, if
+// they're a symbol name.  Threads that hash the same string at once
+// work out the same thing.
+static uint32_t hash_string(grim_object obj) {
+    uint32_t h = __atomic_load_n(&I_strhash(obj), __ATOMIC_RELAXED);
+    if (!h) {
+        h = grim_hash_bytes((char *) I_str(obj), I_strlen(obj), 0);
+        __atomic_store_n(&I_strhash(obj), h, __ATOMIC_RELAXED);
+    }
+    return h;
+}
+
 static uint64_t hash_bigint(mpz_t n, uint64_t h) {
-    h += hash_uint64(n->_mp_size);
-    return hash_buffer((char *) n->_mp_d, n->_mp_size * sizeof(n->_mp_d[0]), h);
+    // The size is negative for negative numbers, so the sign goes in
+    // separately
+    h += hash_uint64(mpz_size(n) + mpz_sgn(n));
+    return grim_hash_bytes((char *) n->_mp_d, mpz_size(n) * sizeof(mp_limb_t), h);
 }
 
-static uint64_t hash_int_float(uint64_t n, double f, uint64_t h) {
+static uint64_t hash_double(double f, uint64_t h) {
     uint64_t m = *((uint64_t *) (&f));
-    return hash_uint64((3*n + m) - h);
+    return hash_uint64(m - h);
 }
 
 
-uint64_t grim_hash(grim_object obj, uint64_t h) {
+// Conses, vectors and complex numbers are hashed by what they hold, as
+// far as a budget of GRIM_HASH_BUDGET objects goes, so that long, deep
+// and cyclic structures take bounded time.  Equal structures are walked
+// alike, and run out of budget at the same point, so their hashes
+// agree.  Within them, symbols are hashed by name, and objects that are
+// only equal to themselves by type alone, so that the hash doesn't
+// depend on where anything is, and stays valid in images.
+#define GRIM_HASH_BUDGET (64)
+
+static uint64_t hash_value(grim_object obj, uint64_t h, int *budget);
+
+// Lists are followed along their cdrs, rather than recursed into
+static uint64_t hash_cons(grim_object obj, uint64_t h, int *budget) {
+    do {
+        h = hash_value(I_car(obj), hash_uint64(h + GRIM_CONS_TAG), budget);
+        obj = I_cdr(obj);
+    } while (*budget > 0 && (obj & 0x0f) == GRIM_CONS_TAG);
+    return hash_value(obj, h, budget);
+}
+
+static inline uint64_t hash_indirect(grim_object obj, uint64_t h, int *budget) {
     h += hash_uint64(grim_type(obj));
+    switch (I_tag(obj)) {
+    case GRIM_FLOAT_TAG:
+        return hash_double(I_floating(obj), h);
+    case GRIM_BIGINT_TAG:
+        return hash_bigint(I_bigint(obj), h);
+    case GRIM_RATIONAL_TAG:
+        return hash_bigint(mpq_denref(I_rational(obj)), hash_bigint(mpq_numref(I_rational(obj)), h));
+    case GRIM_COMPLEX_TAG:
+        return hash_value(I_imag(obj), hash_value(I_real(obj), h, budget), budget);
+    case GRIM_STRING_TAG:
+        return hash_uint64(hash_string(obj) + h);
+    case GRIM_VECTOR_TAG:
+        h = hash_uint64(h + I_vectorlen(obj));
+        for (size_t i = 0; i < I_vectorlen(obj) && *budget > 0; i++)
+            h = hash_value(I_vectorelt(obj, i), h, budget);
+        return h;
+    case GRIM_BUFFER_TAG:
+        return grim_hash_bytes(I_buf(obj), I_buflen(obj), h);
+    case GRIM_F64VECTOR_TAG:
+    case GRIM_S64VECTOR_TAG:
+    case GRIM_BYTEVECTOR_TAG:
+        return grim_hash_bytes(I_numdata(obj), I_numlen(obj) * grim_numvector_eltsize(I_tag(obj)), h);
+    default:
+        return h;
+    }
+}
 
-    switch (grim_direct_tag(obj)) {
+static uint64_t hash_value(grim_object obj, uint64_t h, int *budget) {
+    if (*budget <= 0)
+        return h;
+    (*budget)--;
+    // Fixnums are odd, so they never pass for anything else here
+    switch (obj & 0x0f) {
     case GRIM_INDIRECT_TAG:
-        switch (I_tag(obj)) {
-        case GRIM_BIGINT_TAG:
-            return hash_bigint(I_bigint(obj), h);
-        case GRIM_STRING_TAG:
-            return hash_buffer((char *) I_str(obj), I_strlen(obj), h);
-        case GRIM_BUFFER_TAG:
-            return hash_buffer(I_buf(obj), I_buflen(obj), h);
-        default:
-            assert(false);
-            return 0;
-        }
+        return hash_indirect(obj, h, budget);
+    case GRIM_CONS_TAG:
+        return hash_cons(obj, h, budget);
+    case GRIM_SYMBOL_TAG:
+        return hash_uint64(h ^ I_symbolhash(obj));
+    default:
+        return hash_uint64(h ^ obj);
     }
+}
 
-    return hash_int_float((uint64_t) obj, (double) obj, h);
+uint64_t grim_hash(grim_object obj, uint64_t h) {
+    if (GRIM_HASHED_BY_IDENTITY(obj))
+        return grim_hash_identity(obj, h);
+    int budget = GRIM_HASH_BUDGET;
+    if ((obj & 0x0f) == GRIM_CONS_TAG)
+        return hash_cons(obj, h, &budget);
+    if (grim_hashed_by_address(obj))
+        return grim_hash_identity(obj, h);
+    return hash_indirect(obj, h, &budget);
 }
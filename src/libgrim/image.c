@@ -0,0 +1,672 @@
+#define _GNU_SOURCE
+#include <assert.h>
+#include <dlfcn.h>
+#include <fcntl.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "gc.h"
+#include "gmp.h"
+
+#include "grim.h"
+#include "internal.h"
+
+
+// Heap images
+// -----------------------------------------------------------------------------
+
+// An image is a copy of everything reachable from a root object, the
+// builtin module and the symbol table, laid out as it would be in
+// memory if the file were mapped at GRIM_IMAGE_BASE.  Loading maps the
+// file there if that address range is free, in which case there is
+// almost nothing left to do, and the cost of startup doesn't depend on
+// the size of the image.  Otherwise every pointer in it is moved by
+// the difference, following a table of their locations.
+//
+// Pointers to C functions are stored relative to libgrim's own code,
+// so an image can only be loaded by the build that wrote it, and can
+// only refer to functions in libgrim itself.  Symbols
+// and hash tables need some care: see grim_image_open.
+//
+// The file is laid out as a header, the objects themselves, and then,
+// starting on a page boundary, the tables needed to load it, which are
+// unmapped once that is done.  The objects are mapped privately, so
+// they can be changed like any others, and they are never collected.
+// They may come to point into the collected heap, so the collector
+// scans them, as it does static data.
+
+#define GRIM_IMAGE_MAGIC "GRIMIMG"
+#define GRIM_IMAGE_VERSION (3)
+#define GRIM_IMAGE_BASE ((uintptr_t) 0x200000000000)
+#define GRIM_IMAGE_PAGE (4096)
+
+typedef struct {
+    char magic[8];
+    uint64_t version;
+    uint64_t fingerprint;
+    uint64_t size;
+
+    // Where the objects start and end
+    uint64_t objstart;
+    uint64_t objend;
+
+    // The root object and the builtin module, stored like any fields
+    uint64_t roots;
+
+    // The symbol table's bucket array
+    uint64_t symbols;
+    uint64_t symbolcap;
+    uint64_t symbolfill;
+
+    // Offsets of words holding pointers into the image, words holding
+    // symbols, words holding C function pointers, and hash tables
+    uint64_t relocs, nrelocs;
+    uint64_t symrefs, nsymrefs;
+    uint64_t coderelocs, ncoderelocs;
+    uint64_t tables, ntables;
+
+    grim_type_stats_t types[GRIM_NTYPES];
+} grim_image_header;
+
+// Anything that changes the layout of objects, moves libgrim's code
+// relative to its data, or changes how bytes are hashed, should change
+// this
+static uint64_t grim_image_fingerprint() {
+    uint64_t h = GRIM_NTYPES;
+    h = h * 31 + sizeof(grim_object);
+    h = h * 31 + sizeof(grim_istring);
+    h = h * 31 + sizeof(grim_isymbol);
+    h = h * 31 + sizeof(grim_ifunc);
+    h = h * 31 + sizeof(grim_ihashtable);
+    h = h * 31 + GRIM_HASHTABLE_GROUP;
+    h = h * 31 + sizeof(mp_limb_t);
+    h = h * 31 + grim_hash_bytes("grim", 4, 0);
+    h = h * 31 + ((uintptr_t) &grim_builtin_module - (uintptr_t) grim_image_save);
+    return h;
+}
+
+
+// Writing
+// -----------------------------------------------------------------------------
+
+// The writer copies objects breadth first into a growing buffer.  Each
+// object is copied verbatim, and if it holds other objects, it's
+// queued, and they are replaced by their copies when it comes off the
+// queue.  A map from addresses to offsets keeps track of what has
+// already been copied.
+
+typedef struct {
+    uint64_t *data;
+    size_t len;
+    size_t cap;
+} grim_image_list;
+
+typedef struct {
+    uintptr_t *keys;
+    uint64_t *values;
+    size_t fill;
+    size_t cap;
+} grim_image_map;
+
+typedef struct {
+    char *data;
+    size_t len;
+    size_t cap;
+    grim_image_map copied;
+    grim_image_list queue;
+    grim_image_list relocs;
+    grim_image_list symrefs;
+    grim_image_list coderelocs;
+    grim_image_list tables;
+    grim_type_stats_t types[GRIM_NTYPES];
+    bool ok;
+} grim_image_writer;
+
+static void grim_image_list_push(grim_image_list *list, uint64_t value) {
+    if (list->len == list->cap) {
+        list->cap = list->cap ? 2 * list->cap : 256;
+        list->data = realloc(list->data, list->cap * sizeof(uint64_t));
+        assert(list->data);
+    }
+    list->data[list->len++] = value;
+}
+
+static size_t grim_image_map_slot(grim_image_map *map, uintptr_t key) {
+    size_t i = (key >> 4) * 0x9e3779b97f4a7c15 >> 20;
+    for (i &= map->cap - 1; map->keys[i] && map->keys[i] != key; i = (i + 1) & (map->cap - 1));
+    return i;
+}
+
+static void grim_image_map_set(grim_image_map *map, uintptr_t key, uint64_t value) {
+    if (2 * (map->fill + 1) > map->cap) {
+        grim_image_map old = *map;
+        map->cap = old.cap ? 2 * old.cap : 1024;
+        map->keys = calloc(map->cap, sizeof(uintptr_t));
+        map->values = malloc(map->cap * sizeof(uint64_t));
+        assert(map->keys && map->values);
+        for (size_t i = 0; i < old.cap; i++) {
+            if (!old.keys[i])
+                continue;
+            size_t slot = grim_image_map_slot(map, old.keys[i]);
+            map->keys[slot] = old.keys[i];
+            map->values[slot] = old.values[i];
+        }
+        free(old.keys);
+        free(old.values);
+    }
+    size_t slot = grim_image_map_slot(map, key);
+    map->fill += !map->keys[slot];
+    map->keys[slot] = key;
+    map->values[slot] = value;
+}
+
+static bool grim_image_map_get(grim_image_map *map, uintptr_t key, uint64_t *value) {
+    if (!map->cap)
+        return false;
+    size_t slot = grim_image_map_slot(map, key);
+    if (!map->keys[slot])
+        return false;
+    *value = map->values[slot];
+    return true;
+}
+
+#define W_AT(w, type, offset) (*(type *) ((w)->data + (offset)))
+
+// Reserves zeroed space in the image, returning its offset
+static uint64_t grim_image_alloc(grim_image_writer *w, size_t size) {
+    size = (size + GRIM_GRANULE_BYTES - 1) & ~(size_t) (GRIM_GRANULE_BYTES - 1);
+    if (w->len + size > w->cap) {
+        size_t newcap = 2 * w->cap;
+        while (w->len + size > newcap)
+            newcap *= 2;
+        w->data = realloc(w->data, newcap);
+        assert(w->data);
+        memset(w->data + w->cap, 0, newcap - w->cap);
+        w->cap = newcap;
+    }
+    uint64_t retval = w->len;
+    w->len += size;
+    return retval;
+}
+
+static uint64_t grim_image_copy_bytes(grim_image_writer *w, const void *src, size_t size) {
+    uint64_t offset = grim_image_alloc(w, size);
+    memcpy(w->data + offset, src, size);
+    return offset;
+}
+
+static void grim_image_census(grim_image_writer *w, grim_type_t type, size_t size) {
+    w->types[type].count++;
+    w->types[type].bytes += (size + GRIM_GRANULE_BYTES - 1) & ~(size_t) (GRIM_GRANULE_BYTES - 1);
+}
+
+// Stores a pointer to the given offset at another offset
+static void grim_image_link(grim_image_writer *w, uint64_t at, uint64_t offset, uintptr_t tag) {
+    W_AT(w, uintptr_t, at) = GRIM_IMAGE_BASE + offset + tag;
+    grim_image_list_push(&w->relocs, at);
+}
+
+// Copies a payload, and points to it from the given offset
+static void grim_image_payload(grim_image_writer *w, uint64_t at, const void *src, size_t size) {
+    if (!src) {
+        W_AT(w, void *, at) = NULL;
+        return;
+    }
+    grim_image_link(w, at, grim_image_copy_bytes(w, src, size), 0);
+}
+
+static size_t grim_image_limbs(grim_image_writer *w, uint64_t at) {
+    __mpz_struct *num = &W_AT(w, __mpz_struct, at);
+    size_t nlimbs = num->_mp_size < 0 ? -num->_mp_size : num->_mp_size;
+    if (nlimbs == 0)
+        nlimbs = 1;
+    num->_mp_alloc = nlimbs;
+    grim_image_payload(w, at + offsetof(__mpz_struct, _mp_d), num->_mp_d, nlimbs * sizeof(mp_limb_t));
+    return nlimbs * sizeof(mp_limb_t);
+}
+
+// Copies an indirect object or a cons, returning its offset.  Payloads
+// without pointers are copied along with it, and objects with pointers
+// are queued to have them filled in.
+static uint64_t grim_image_copy(grim_image_writer *w, grim_object obj) {
+    uint64_t offset;
+    uintptr_t addr = obj & ~(uintptr_t) 0x0f;
+    if (grim_image_map_get(&w->copied, addr, &offset))
+        return offset;
+
+    if (grim_direct_tag(obj) == GRIM_CONS_TAG) {
+        offset = grim_image_copy_bytes(w, (const void *) addr, sizeof(grim_icons));
+        grim_image_map_set(&w->copied, addr, offset);
+        grim_image_list_push(&w->queue, offset | GRIM_CONS_TAG);
+        return offset;
+    }
+
+    size_t size, extra = 0;
+    bool queue = false;
+    switch (I_tag(obj)) {
+    case GRIM_FLOAT_TAG: size = sizeof(grim_ifloat); break;
+    case GRIM_BIGINT_TAG: size = sizeof(grim_ibigint); break;
+    case GRIM_RATIONAL_TAG: size = sizeof(grim_irational); break;
+    case GRIM_COMPLEX_TAG: size = sizeof(grim_icomplex); queue = true; break;
+    case GRIM_STRING_TAG:
+        size = sizeof(grim_istring);
+        if (I_str(obj) == IX(string, obj)->sinline)
+            size += I_strlen(obj) + 1;
+        break;
+    case GRIM_VECTOR_TAG: size = sizeof(grim_ivector); queue = true; break;
+    case GRIM_BUFFER_TAG: size = sizeof(grim_ibuffer); break;
+    case GRIM_F64VECTOR_TAG:
+    case GRIM_S64VECTOR_TAG:
+    case GRIM_BYTEVECTOR_TAG: size = sizeof(grim_inumvector); break;
+    case GRIM_HASHTABLE_TAG: size = sizeof(grim_ihashtable); queue = true; break;
+    case GRIM_CELL_TAG: size = sizeof(grim_icell); queue = true; break;
+    case GRIM_MODULE_TAG: size = sizeof(grim_imodule); queue = true; break;
+    case GRIM_CFUNC_TAG: size = sizeof(grim_ifunc); break;
+    case GRIM_LFUNC_TAG: size = sizeof(grim_ifunc); queue = true; break;
+    default:
+        // Frames are the state of a running program
+        w->ok = false;
+        return grim_image_alloc(w, sizeof(grim_indirect));
+    }
+
+    offset = grim_image_copy_bytes(w, (const void *) addr, size);
+    grim_image_map_set(&w->copied, addr, offset);
+    if (queue) {
+        grim_image_list_push(&w->queue, offset);
+        return offset;
+    }
+
+    switch (I_tag(obj)) {
+    case GRIM_BIGINT_TAG:
+        extra = grim_image_limbs(w, offset + offsetof(grim_ibigint, bigint));
+        break;
+    case GRIM_RATIONAL_TAG:
+        extra = grim_image_limbs(w, offset + offsetof(grim_irational, rational[0]._mp_num));
+        extra += grim_image_limbs(w, offset + offsetof(grim_irational, rational[0]._mp_den));
+        break;
+    case GRIM_STRING_TAG:
+        if (I_str(obj) == IX(string, obj)->sinline)
+            grim_image_link(w, offset + offsetof(grim_istring, sbuf),
+                            offset + offsetof(grim_istring, sinline), 0);
+        else {
+            extra = I_strlen(obj) + 1;
+            grim_image_payload(w, offset + offsetof(grim_istring, sbuf), I_str(obj), extra);
+        }
+        break;
+    case GRIM_BUFFER_TAG: {
+        // Buffers grow by a factor, so they need some capacity to start
+        size_t cap = I_buflen(obj) > GRIM_GRANULE_BYTES ? I_buflen(obj) : GRIM_GRANULE_BYTES;
+        uint64_t buf = grim_image_alloc(w, cap);
+        memcpy(w->data + buf, I_buf(obj), I_buflen(obj));
+        grim_image_link(w, offset + offsetof(grim_ibuffer, cbuf), buf, 0);
+        W_AT(w, grim_ibuffer, offset).bufcap = extra = cap;
+        break;
+    }
+    case GRIM_F64VECTOR_TAG:
+    case GRIM_S64VECTOR_TAG:
+    case GRIM_BYTEVECTOR_TAG:
+        extra = I_numlen(obj) * grim_numvector_eltsize(I_tag(obj));
+        grim_image_payload(w, offset + offsetof(grim_inumvector, nbuf), I_numdata(obj), extra);
+        break;
+    case GRIM_CFUNC_TAG: {
+        Dl_info func, self;
+        if (!dladdr((void *) I_cfunc(obj), &func) || !dladdr((void *) grim_image_save, &self) ||
+            func.dli_fbase != self.dli_fbase)
+            w->ok = false;
+        W_AT(w, grim_ifunc, offset).cfunc = (grim_cfunc *) ((uintptr_t) I_cfunc(obj) - (uintptr_t) grim_image_save);
+        grim_image_list_push(&w->coderelocs, offset + offsetof(grim_ifunc, cfunc));
+        break;
+    }
+    }
+    grim_image_census(w, grim_type(obj), size + extra);
+    return offset;
+}
+
+// The hash a key will have in the image, which for keys that hash by
+// address is that of their copy
+static uint64_t grim_image_hash(grim_image_writer *w, grim_object key) {
+    uint64_t offset = 0;
+    if (grim_direct_tag(key) == GRIM_SYMBOL_TAG) {
+        if (!grim_image_map_get(&w->copied, key - GRIM_SYMBOL_TAG, &offset))
+            assert(false);
+        return grim_hash_identity(GRIM_IMAGE_BASE + offset + GRIM_SYMBOL_TAG, 0);
+    }
+    if (grim_hashed_by_address(key))
+        return grim_hash_identity(GRIM_IMAGE_BASE + grim_image_copy(w, key), 0);
+    return grim_hash(key, 0);
+}
+
+// Replaces the object stored at the given offset by its copy
+static void grim_image_field(grim_image_writer *w, uint64_t at) {
+    grim_object obj = W_AT(w, grim_object, at);
+    uint64_t offset;
+    switch (grim_direct_tag(obj)) {
+    case GRIM_SYMBOL_TAG:
+        // All symbols are copied up front
+        if (!grim_image_map_get(&w->copied, obj - GRIM_SYMBOL_TAG, &offset))
+            assert(false);
+        grim_image_link(w, at, offset, GRIM_SYMBOL_TAG);
+        grim_image_list_push(&w->symrefs, at);
+        break;
+    case GRIM_CONS_TAG:
+        grim_image_link(w, at, grim_image_copy(w, obj), GRIM_CONS_TAG);
+        break;
+    case GRIM_INDIRECT_TAG:
+        grim_image_link(w, at, grim_image_copy(w, obj), 0);
+        break;
+    }
+}
+
+// Fills in the pointers of an object taken off the queue.  Its fields
+// still hold the original pointers at this point.
+static void grim_image_scan(grim_image_writer *w, uint64_t offset) {
+    if (offset & GRIM_CONS_TAG) {
+        offset -= GRIM_CONS_TAG;
+        grim_image_field(w, offset + offsetof(grim_icons, car));
+        grim_image_field(w, offset + offsetof(grim_icons, cdr));
+        grim_image_census(w, GRIM_CONS, sizeof(grim_icons));
+        return;
+    }
+
+    grim_tag_t tag = W_AT(w, grim_indirect, offset).tag;
+    size_t size = 0;
+    switch (tag) {
+    case GRIM_COMPLEX_TAG:
+        grim_image_field(w, offset + offsetof(grim_icomplex, real));
+        grim_image_field(w, offset + offsetof(grim_icomplex, imag));
+        size = sizeof(grim_icomplex);
+        break;
+    case GRIM_VECTOR_TAG: {
+        // Spare capacity is dropped
+        grim_ivector src = W_AT(w, grim_ivector, offset);
+        W_AT(w, grim_ivector, offset).bufcap = src.buflen;
+        size = sizeof(grim_ivector) + src.buflen * sizeof(grim_object);
+        grim_image_payload(w, offset + offsetof(grim_ivector, obuf),
+                           src.buflen ? src.obuf : NULL, src.buflen * sizeof(grim_object));
+        uint64_t elts = src.buflen ? W_AT(w, uintptr_t, offset + offsetof(grim_ivector, obuf)) - GRIM_IMAGE_BASE : 0;
+        for (size_t i = 0; i < src.buflen; i++)
+            grim_image_field(w, elts + i * sizeof(grim_object));
+        break;
+    }
+    case GRIM_HASHTABLE_TAG: {
+        // Keys that hash by address (symbols and conses) hash
+        // differently here, so the entries are placed anew, as they
+        // would be if the image were loaded where it wants.  They're
+        // written in order and without holes.  A table that is growing
+        // is written out as if it were done, and a concurrent table as
+        // an ordinary one.  The copy still has the original slots, so
+        // it stands in for the table while its entries are gone through.
+        _Alignas(16) grim_ihashtable src = W_AT(w, grim_ihashtable, offset);
+        size_t entries = src.buflen, cap = src.slots.cap;
+        if (src.shards) {
+            entries = 0;
+            for (size_t k = 0; k < GRIM_HASHTABLE_SHARDS; k++)
+                entries += I_hashfill(src.shards[k].table);
+            while (GRIM_HASHTABLE_MAX_FILL(cap) < entries)
+                cap *= 2;
+        }
+        size_t room = GRIM_HASHTABLE_MAX_FILL(cap);
+        uint64_t ctrl = grim_image_alloc(w, cap + GRIM_HASHTABLE_GROUP);
+        uint64_t index = grim_image_alloc(w, cap * sizeof(uint32_t));
+        uint64_t keys = grim_image_alloc(w, room * sizeof(grim_object));
+        uint64_t values = grim_image_alloc(w, room * sizeof(grim_object));
+        uint64_t hashes = grim_image_alloc(w, room * sizeof(uint64_t));
+        grim_image_link(w, offset + offsetof(grim_ihashtable, slots.ctrl), ctrl, 0);
+        grim_image_link(w, offset + offsetof(grim_ihashtable, slots.index), index, 0);
+        grim_image_link(w, offset + offsetof(grim_ihashtable, slots.keys), keys, 0);
+        grim_image_link(w, offset + offsetof(grim_ihashtable, slots.values), values, 0);
+        grim_image_link(w, offset + offsetof(grim_ihashtable, slots.hashes), hashes, 0);
+        W_AT(w, grim_ihashtable, offset).slots.cap = cap;
+        W_AT(w, grim_ihashtable, offset).oldslots = (grim_hashslots) {0};
+        W_AT(w, grim_ihashtable, offset).migrated = 0;
+        W_AT(w, grim_ihashtable, offset).placed = 0;
+        W_AT(w, grim_ihashtable, offset).shards = NULL;
+        grim_image_list_push(&w->tables, offset);
+        grim_hashtable_ctrl_init(&W_AT(w, int8_t, ctrl), cap);
+        size = sizeof(grim_ihashtable) + cap + GRIM_HASHTABLE_GROUP + cap * sizeof(uint32_t) +
+            room * (2 * sizeof(grim_object) + sizeof(uint64_t));
+
+        // Weak references that have been cleared are left out
+        size_t fill = 0;
+        grim_object key, value;
+        for (size_t pos = 0; grim_hashtable_next((grim_object) &src, &pos, &key, &value); fill++) {
+            uint64_t hash = grim_image_hash(w, key);
+            size_t i = grim_hashtable_place(&W_AT(w, int8_t, ctrl), cap, hash);
+            W_AT(w, uint32_t, index + i * sizeof(uint32_t)) = fill;
+            W_AT(w, grim_object, keys + fill * sizeof(grim_object)) = key;
+            W_AT(w, grim_object, values + fill * sizeof(grim_object)) = value;
+            W_AT(w, uint64_t, hashes + fill * sizeof(uint64_t)) = hash;
+            grim_image_field(w, keys + fill * sizeof(grim_object));
+            grim_image_field(w, values + fill * sizeof(grim_object));
+        }
+        W_AT(w, grim_ihashtable, offset).slots.used = fill;
+        W_AT(w, grim_ihashtable, offset).buflen = fill;
+        break;
+    }
+    case GRIM_CELL_TAG:
+        grim_image_field(w, offset + offsetof(grim_icell, cellvalue));
+        size = sizeof(grim_icell);
+        break;
+    case GRIM_MODULE_TAG:
+        grim_image_field(w, offset + offsetof(grim_imodule, modulename));
+        grim_image_field(w, offset + offsetof(grim_imodule, modulemembers));
+        size = sizeof(grim_imodule);
+        break;
+    case GRIM_LFUNC_TAG:
+        grim_image_field(w, offset + offsetof(grim_ifunc, bytecode));
+        grim_image_field(w, offset + offsetof(grim_ifunc, funcrefs));
+        size = sizeof(grim_ifunc);
+        break;
+    }
+    grim_image_census(w, grim_type((grim_object) &W_AT(w, grim_indirect, offset)), size);
+}
+
+// Copies every interned symbol, with its chain, and the bucket array
+static uint64_t grim_image_symbols(grim_image_writer *w, size_t *cap, size_t *fill) {
+    grim_isymbol **table = grim_symbols_table(cap, fill);
+    for (size_t i = 0; i < *cap; i++)
+        for (grim_isymbol *sym = table[i]; sym; sym = sym->symbolnext) {
+            size_t size = sizeof(grim_isymbol) + sym->symbolname.buflen + 1;
+            uint64_t offset = grim_image_copy_bytes(w, sym, size);
+            grim_image_map_set(&w->copied, (uintptr_t) sym, offset);
+            grim_image_map_set(&w->copied, (uintptr_t) &sym->symbolname,
+                               offset + offsetof(grim_isymbol, symbolname));
+            grim_image_link(w, offset + offsetof(grim_isymbol, symbolname.sbuf),
+                            offset + offsetof(grim_isymbol, symbolname.sinline), 0);
+            grim_image_census(w, GRIM_SYMBOL, size);
+        }
+
+    uint64_t buckets = grim_image_alloc(w, *cap * sizeof(grim_isymbol *));
+    for (size_t i = 0; i < *cap; i++) {
+        uint64_t at = buckets + i * sizeof(grim_isymbol *);
+        for (grim_isymbol *sym = table[i]; sym; sym = sym->symbolnext) {
+            uint64_t offset;
+            grim_image_map_get(&w->copied, (uintptr_t) sym, &offset);
+            grim_image_link(w, at, offset, 0);
+            at = offset + offsetof(grim_isymbol, symbolnext);
+        }
+        W_AT(w, void *, at) = NULL;
+    }
+    return buckets;
+}
+
+static void grim_image_write_list(FILE *file, grim_image_list *list) {
+    fwrite(list->data, sizeof(uint64_t), list->len, file);
+    free(list->data);
+}
+
+// Saves everything reachable from root, along with the builtin module
+// and all symbols.  Fails if there are frames among them, or if the
+// file can't be written.
+bool grim_image_save(const char *path, grim_object root) {
+    grim_image_writer w = {.ok = true};
+    w.cap = 64 * 1024;
+    w.data = calloc(w.cap, 1);
+    assert(w.data);
+
+    grim_image_header header = {0};
+    w.len = (sizeof(grim_image_header) + GRIM_GRANULE_BYTES - 1) & ~(size_t) (GRIM_GRANULE_BYTES - 1);
+    header.objstart = w.len;
+
+    size_t symbolcap, symbolfill;
+    header.symbols = grim_image_symbols(&w, &symbolcap, &symbolfill);
+    header.symbolcap = symbolcap;
+    header.symbolfill = symbolfill;
+
+    // The roots are stored in the header, like any other field
+    uint64_t roots = grim_image_alloc(&w, 2 * sizeof(grim_object));
+    W_AT(&w, grim_object, roots) = root;
+    W_AT(&w, grim_object, roots + sizeof(grim_object)) = grim_builtin_module;
+    grim_image_field(&w, roots);
+    grim_image_field(&w, roots + sizeof(grim_object));
+    for (size_t i = 0; i < w.queue.len; i++)
+        grim_image_scan(&w, w.queue.data[i]);
+    header.roots = roots;
+    header.objend = w.len;
+
+    free(w.queue.data);
+    free(w.copied.keys);
+    free(w.copied.values);
+
+    FILE *file = w.ok ? fopen(path, "wb") : NULL;
+    if (!file) {
+        free(w.data);
+        free(w.relocs.data);
+        free(w.symrefs.data);
+        free(w.coderelocs.data);
+        free(w.tables.data);
+        return false;
+    }
+
+    uint64_t at = (w.len + GRIM_IMAGE_PAGE - 1) & ~(uint64_t) (GRIM_IMAGE_PAGE - 1);
+    header.relocs = at;
+    header.nrelocs = w.relocs.len;
+    header.symrefs = at += w.relocs.len * sizeof(uint64_t);
+    header.nsymrefs = w.symrefs.len;
+    header.coderelocs = at += w.symrefs.len * sizeof(uint64_t);
+    header.ncoderelocs = w.coderelocs.len;
+    header.tables = at += w.coderelocs.len * sizeof(uint64_t);
+    header.ntables = w.tables.len;
+    header.size = at + w.tables.len * sizeof(uint64_t);
+
+    memcpy(header.magic, GRIM_IMAGE_MAGIC, sizeof(header.magic));
+    header.version = GRIM_IMAGE_VERSION;
+    header.fingerprint = grim_image_fingerprint();
+    memcpy(header.types, w.types, sizeof(header.types));
+    memcpy(w.data, &header, sizeof(header));
+
+    fwrite(w.data, 1, w.len, file);
+    for (uint64_t pad = w.len; pad < header.relocs; pad++)
+        fputc(0, file);
+    free(w.data);
+    grim_image_write_list(file, &w.relocs);
+    grim_image_write_list(file, &w.symrefs);
+    grim_image_write_list(file, &w.coderelocs);
+    grim_image_write_list(file, &w.tables);
+    bool ok = !ferror(file);
+    return fclose(file) == 0 && ok;
+}
+
+
+// Loading
+// -----------------------------------------------------------------------------
+
+// Maps an image and makes it ready for use.  If fresh is true, the
+// interpreter is still empty, and the image's symbol table and builtin
+// module become the interpreter's own.  Otherwise its symbols are
+// merged into those already there.
+grim_object grim_image_open(const char *path, bool fresh) {
+    int fd = open(path, O_RDONLY);
+    if (fd < 0)
+        return grim_undefined;
+
+    grim_image_header header;
+    struct stat st;
+    if (pread(fd, &header, sizeof(header), 0) != sizeof(header) ||
+        fstat(fd, &st) != 0 ||
+        memcmp(header.magic, GRIM_IMAGE_MAGIC, sizeof(header.magic)) ||
+        header.version != GRIM_IMAGE_VERSION ||
+        header.fingerprint != grim_image_fingerprint() ||
+        header.size != (uint64_t) st.st_size) {
+        close(fd);
+        return grim_undefined;
+    }
+
+    char *map = mmap((void *) GRIM_IMAGE_BASE, header.size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED)
+        return grim_undefined;
+
+    // Tagged pointers stay tagged, as the difference is a whole number
+    // of pages
+    uintptr_t delta = (uintptr_t) map - GRIM_IMAGE_BASE;
+    uint64_t *offsets = (uint64_t *) (map + header.relocs);
+    if (delta)
+        for (uint64_t i = 0; i < header.nrelocs; i++)
+            *(uintptr_t *) (map + offsets[i]) += delta;
+
+    offsets = (uint64_t *) (map + header.coderelocs);
+    for (uint64_t i = 0; i < header.ncoderelocs; i++)
+        *(uintptr_t *) (map + offsets[i]) += (uintptr_t) grim_image_save;
+
+    grim_isymbol **buckets = (grim_isymbol **) (map + header.symbols);
+    bool moved = delta != 0;
+    if (fresh)
+        grim_symbols_adopt(buckets, header.symbolcap, header.symbolfill);
+    else {
+        // Gather the symbols first, as merging relinks them
+        size_t nsymbols = 0;
+        grim_isymbol **symbols = malloc(header.symbolfill * sizeof(grim_isymbol *));
+        assert(symbols || !header.symbolfill);
+        for (uint64_t i = 0; i < header.symbolcap; i++)
+            for (grim_isymbol *sym = buckets[i]; sym; sym = sym->symbolnext)
+                symbols[nsymbols++] = sym;
+        for (size_t i = 0; i < nsymbols; i++)
+            moved |= grim_symbols_merge(symbols[i]) != symbols[i];
+        free(symbols);
+
+        // Symbols that were already interned replace those in the
+        // image.  A merged symbol is found by its own name, so it
+        // stays as it is.
+        offsets = (uint64_t *) (map + header.symrefs);
+        if (moved)
+            for (uint64_t i = 0; i < header.nsymrefs; i++) {
+                grim_object *ref = (grim_object *) (map + offsets[i]);
+                grim_isymbol *sym = (grim_isymbol *) (*ref - GRIM_SYMBOL_TAG);
+                *ref = (grim_object) grim_symbols_merge(sym) | GRIM_SYMBOL_TAG;
+            }
+    }
+
+    // Rehashing allocates, so the objects must be visible by then.  As
+    // the image is scanned whole, weak tables are always moved out into
+    // the collected heap, or their references would all be strong.
+    GC_add_roots(map + header.objstart, map + header.objend);
+    offsets = (uint64_t *) (map + header.tables);
+    for (uint64_t i = 0; i < header.ntables; i++) {
+        grim_object table = (grim_object) (map + offsets[i]);
+        if (moved || I_weakness(table) != GRIM_STRONG)
+            grim_hashtable_rehash(table);
+    }
+
+    grim_census_image(header.types);
+    grim_object *roots = (grim_object *) (map + header.roots);
+    if (fresh)
+        grim_builtin_module = roots[1];
+
+    long pagesize = sysconf(_SC_PAGESIZE);
+    if (pagesize > 0 && header.relocs % pagesize == 0)
+        munmap(map + header.relocs, header.size - header.relocs);
+
+    return roots[0];
+}
+
+grim_object grim_image_load(const char *path) {
+    return grim_image_open(path, false);
+}
@@ -1,5 +1,8 @@
 #pragma once
 
+#include <pthread.h>
+#include <stdalign.h>
+#include <stdatomic.h>
 #include <stddef.h>
 #include <stdint.h>
 
@@ -10,19 +13,35 @@
 typedef uint8_t grim_tag_t;
 
 #define GRIM_ALIGN alignof(max_align_t)
+#define GRIM_GRANULE_BYTES (16)
+#define GRIM_SMALL_GRANULES (4)
 #define GRIM_FIXNUM_MAX (INTPTR_MAX / 2)
 #define GRIM_FIXNUM_MIN (INTPTR_MIN / 2)
 
+// Immediate floats keep every bit of the double except the four bits
+// after the top exponent bit, which must all be equal to the negation
+// of it. This covers magnitudes from 2^-63 up to 2^65.  The encoding of
+// 2^-63 itself is reserved for positive zero.
+#define GRIM_FLONUM_ZERO (((grim_object) 1 << 63) | GRIM_FLONUM_TAG)
+
 // Immediate types
 enum {
     GRIM_INDIRECT_TAG  = 0b0000,
     GRIM_FIXNUM_TAG    = 0b0001,
     GRIM_CHARACTER_TAG = 0b0010,
     GRIM_SYMBOL_TAG    = 0b0100,
-    GRIM_UNDEFINED_TAG = 0b0110,
-    GRIM_FALSE_TAG     = 0b1000,
-    GRIM_TRUE_TAG      = 0b1010,
-    GRIM_NIL_TAG       = 0b1100,
+    GRIM_SPECIAL_TAG   = 0b0110,
+    GRIM_CONS_TAG      = 0b1000,
+    GRIM_FLONUM_TAG    = 0b1110,
+};
+
+// Special constants share GRIM_SPECIAL_TAG, and are told apart by the
+// upper half of the low byte
+enum {
+    GRIM_UNDEFINED_TAG = 0x06,
+    GRIM_FALSE_TAG     = 0x16,
+    GRIM_TRUE_TAG      = 0x26,
+    GRIM_NIL_TAG       = 0x36,
 };
 
 // Indirect types
@@ -33,143 +52,238 @@ enum {
     GRIM_COMPLEX_TAG   = 0x03,
     GRIM_STRING_TAG    = 0x04,
     GRIM_VECTOR_TAG    = 0x05,
-    GRIM_CONS_TAG      = 0x06,
     GRIM_BUFFER_TAG    = 0x07,
     GRIM_HASHTABLE_TAG = 0x08,
     GRIM_CELL_TAG      = 0x09,
+    GRIM_F64VECTOR_TAG = 0x0a,
+    GRIM_S64VECTOR_TAG = 0x0b,
+    GRIM_BYTEVECTOR_TAG = 0x0c,
     GRIM_MODULE_TAG    = 0x10,
     GRIM_CFUNC_TAG     = 0x11,
     GRIM_LFUNC_TAG     = 0x12,
     GRIM_FRAME_TAG     = 0x13,
 };
 
-struct grim_hashnode_t {
-    grim_object key;
-    grim_object value;
-    uint64_t hash;
-    struct grim_hashnode_t *next;
-};
-
-typedef struct grim_hashnode_t grim_hashnode;
-
+// Every indirect object starts with its tag. The rest of the layout
+// depends on the type, so that each object is only as large as it
+// needs to be.
 typedef struct {
     grim_tag_t tag;
-    union {
-        // GRIM_FLOAT_TAG
-        struct {
-            double floating;
-        };
-
-        // GRIM_BIGINT_TAG
-        struct {
-            mpz_t bigint;
-        };
+} grim_indirect;
 
-        // GRIM_RATIONAL_TAG
-        struct {
-            mpq_t rational;
-        };
+// GRIM_FLOAT_TAG (floats that are not representable as flonums)
+typedef struct {
+    grim_tag_t tag;
+    double floating;
+} grim_ifloat;
 
-        // GRIM_COMPLEX_TAG
-        struct {
-            grim_object real;
-            grim_object imag;
-        };
+// GRIM_BIGINT_TAG
+typedef struct {
+    grim_tag_t tag;
+    mpz_t bigint;
+} grim_ibigint;
 
-        // GRIM_CONS_TAG
-        struct {
-            grim_object car;
-            grim_object cdr;
-        };
+// GRIM_RATIONAL_TAG
+typedef struct {
+    grim_tag_t tag;
+    mpq_t rational;
+} grim_irational;
 
-        // GRIM_SYMBOL_TAG (via direct)
-        struct {
-            grim_object symbolname;
-        };
+// GRIM_COMPLEX_TAG
+typedef struct {
+    grim_tag_t tag;
+    grim_object real;
+    grim_object imag;
+} grim_icomplex;
 
-        // GRIM_BUFFER_TAG, GRIM_STRING_TAG, GRIM_VECTOR_TAG, GRIM_HASHTABLE_TAG
-        struct {
-            union {
-                char *cbuf;
-                uint8_t *sbuf;
-                grim_object *obuf;
-                grim_hashnode **hbuf;
-            };
-            size_t buflen;
-            size_t bufcap;
-        };
+// GRIM_CONS_TAG (via direct)
+typedef struct {
+    grim_object car;
+    grim_object cdr;
+} grim_icons;
+
+
+// GRIM_STRING_TAG
+// Short strings are stored inline, and sbuf points to sinline.  Longer
+// strings point to separately allocated atomic storage.  Either way the
+// contents are followed by a zero byte.  The hash of the contents is
+// kept in the room after the tag once it's been worked out, and is
+// zero until then, or after the contents change.
+#define GRIM_STRING_INLINE_MAX (16)
+typedef struct {
+    grim_tag_t tag;
+    uint32_t strhash;
+    uint8_t *sbuf;
+    size_t buflen;
+    uint8_t sinline[];
+} grim_istring;
+
+// GRIM_SYMBOL_TAG (via direct)
+// Symbols are immortal, and live in a region of their own.  The name
+// is a complete string object, so it can be used as one.
+typedef struct grim_isymbol_t {
+    uint64_t symbolhash;
+    struct grim_isymbol_t *symbolnext;
+    grim_istring symbolname;
+} grim_isymbol;
+
+// GRIM_BUFFER_TAG
+typedef struct {
+    grim_tag_t tag;
+    char *cbuf;
+    size_t buflen;
+    size_t bufcap;
+} grim_ibuffer;
+
+// GRIM_VECTOR_TAG
+// Vectors may have spare capacity past their length, which is kept
+// zeroed, so that pushing is amortized constant time.
+typedef struct {
+    grim_tag_t tag;
+    grim_object *obuf;
+    size_t buflen;
+    size_t bufcap;
+} grim_ivector;
 
-        // GRIM_CELL_TAG
-        struct {
-            grim_object cellvalue;
-        };
+// GRIM_F64VECTOR_TAG, GRIM_S64VECTOR_TAG, GRIM_BYTEVECTOR_TAG
+// Unboxed numbers in separately allocated atomic storage
+typedef struct {
+    grim_tag_t tag;
+    void *nbuf;
+    size_t buflen;
+} grim_inumvector;
 
-        // GRIM_MODULE_TAG
-        struct {
-            grim_object modulename;
-            grim_object modulemembers;
-        };
+// The slots of a hash table, see objects.c.  The entries are kept in
+// the order they were added, in arrays with room for as many as the
+// table may hold, and the index says which entry each slot is for.
+typedef struct {
+    int8_t *ctrl;
+    uint32_t *index;
+    grim_object *keys;
+    grim_object *values;
+    uint64_t *hashes;
+    size_t cap;
+    size_t used;
+} grim_hashslots;
+
+// A part of a concurrent table, which is an ordinary table of its own.
+// Writers hold the lock, and keep the sequence number odd while they
+// change anything, so that readers, who don't lock, can tell if what
+// they saw was consistent.
+typedef struct {
+    pthread_mutex_t lock;
+    _Atomic size_t seq;
+    grim_object table;
+} grim_hashshard;
+
+// GRIM_HASHTABLE_TAG
+// While a table grows, its entries are spread over its new slots and
+// the old ones, which they are moved out of in order: those before
+// migrated are done, and the next one goes to placed.  The number of
+// entries includes any with cleared weak references.  The entries of a
+// concurrent table are all in its shards instead.
+typedef struct {
+    grim_tag_t tag;
+    uint8_t weakness;
+    grim_hashslots slots;
+    grim_hashslots oldslots;
+    size_t migrated;
+    size_t placed;
+    size_t buflen;
+    grim_hashshard *shards;
+} grim_ihashtable;
+
+#define GRIM_HASHTABLE_GROUP (16)
+#define GRIM_HASHTABLE_MAX_FILL(cap) ((cap) - (cap) / 8)
+#define GRIM_HASHTABLE_SHARDS (16)
+
+// Whether an entry is there, and its weak references, if any, are too
+#define GRIM_HASHENTRY_LIVE(s, e) ((s)->keys[e] && (s)->values[e])
+
+// GRIM_CELL_TAG
+typedef struct {
+    grim_tag_t tag;
+    grim_object cellvalue;
+} grim_icell;
 
-        // GRIM_CFUNC_TAG, GRIM_LFUNC_TAG
-        struct {
-            union {
-                grim_cfunc *cfunc;
-                struct {
-                    grim_object bytecode;
-                    grim_object funcrefs;
-                    uint8_t nlocals;
-                };
-            };
-            uint8_t nargs;
-            bool variadic;
-        };
+// GRIM_MODULE_TAG
+typedef struct {
+    grim_tag_t tag;
+    grim_object modulename;
+    grim_object modulemembers;
+} grim_imodule;
 
-        // GRIM_FRAME_TAG
+// GRIM_CFUNC_TAG, GRIM_LFUNC_TAG
+typedef struct {
+    grim_tag_t tag;
+    uint8_t nargs;
+    bool variadic;
+    uint8_t nlocals;
+    union {
+        grim_cfunc *cfunc;
         struct {
-            grim_object framefunc;
-            grim_object framestack;
-            grim_object parentframe;
+            grim_object bytecode;
+            grim_object funcrefs;
         };
     };
-} grim_indirect;
+} grim_ifunc;
+
+// GRIM_FRAME_TAG
+typedef struct {
+    grim_tag_t tag;
+    grim_object framefunc;
+    grim_object framestack;
+    grim_object parentframe;
+} grim_iframe;
 
 #define I(c) ((grim_indirect *) (c))
+#define IX(t, c) ((grim_i##t *) (c))
 #define I_tag(c) (I(c)->tag)
-#define I_floating(c) (I(c)->floating)
-#define I_bigint(c) (I(c)->bigint)
-#define I_rational(c) (I(c)->rational)
-#define I_real(c) (I(c)->real)
-#define I_imag(c) (I(c)->imag)
-#define I_str(c) (I(c)->sbuf)
-#define I_strlen(c) (I(c)->buflen)
-#define I_vectordata(c) (I(c)->obuf)
-#define I_vectorlen(c) (I(c)->buflen)
-#define I_vectorelt(c, i) (I(c)->obuf[i])
-#define I_car(c) (I(c)->car)
-#define I_cdr(c) (I(c)->cdr)
-#define I_symbolname(c) (I((c) - GRIM_SYMBOL_TAG)->symbolname)
-#define I_buf(c) (I(c)->cbuf)
-#define I_buflen(c) (I(c)->buflen)
-#define I_bufcap(c) (I(c)->bufcap)
-#define I_bufend(c) (I(c)->cbuf[I(c)->buflen])
-#define I_hashnodes(c) (I(c)->hbuf)
-#define I_hashcap(c) (I(c)->bufcap)
-#define I_hashfill(c) (I(c)->buflen)
-#define I_cellvalue(c) (I(c)->cellvalue)
-#define I_modulename(c) (I(c)->modulename)
-#define I_modulemembers(c) (I(c)->modulemembers)
-#define I_cfunc(c) (I(c)->cfunc)
-#define I_bytecode(c) (I(c)->bytecode)
-#define I_funcrefs(c) (I(c)->funcrefs)
-#define I_nlocals(c) (I(c)->nlocals)
-#define I_nargs(c) (I(c)->nargs)
-#define I_variadic(c) (I(c)->variadic)
-#define I_framefunc(c) (I(c)->framefunc)
-#define I_framestack(c) (I(c)->framestack)
-#define I_parentframe(c) (I(c)->parentframe)
-
-// Hash table mapping strings to symbols
-extern grim_object grim_symbol_table;
+#define I_floating(c) (IX(float, c)->floating)
+#define I_bigint(c) (IX(bigint, c)->bigint)
+#define I_rational(c) (IX(rational, c)->rational)
+#define I_real(c) (IX(complex, c)->real)
+#define I_imag(c) (IX(complex, c)->imag)
+#define I_str(c) (IX(string, c)->sbuf)
+#define I_strlen(c) (IX(string, c)->buflen)
+#define I_strhash(c) (IX(string, c)->strhash)
+#define I_vectordata(c) (IX(vector, c)->obuf)
+#define I_vectorlen(c) (IX(vector, c)->buflen)
+#define I_vectorelt(c, i) (IX(vector, c)->obuf[i])
+#define I_vectorcap(c) (IX(vector, c)->bufcap)
+#define I_car(c) (IX(cons, (c) - GRIM_CONS_TAG)->car)
+#define I_cdr(c) (IX(cons, (c) - GRIM_CONS_TAG)->cdr)
+#define I_symbolname(c) ((grim_object) &IX(symbol, (c) - GRIM_SYMBOL_TAG)->symbolname)
+#define I_symbolhash(c) (IX(symbol, (c) - GRIM_SYMBOL_TAG)->symbolhash)
+#define I_buf(c) (IX(buffer, c)->cbuf)
+#define I_buflen(c) (IX(buffer, c)->buflen)
+#define I_bufcap(c) (IX(buffer, c)->bufcap)
+#define I_bufend(c) (IX(buffer, c)->cbuf[IX(buffer, c)->buflen])
+#define I_numdata(c) (IX(numvector, c)->nbuf)
+#define I_numlen(c) (IX(numvector, c)->buflen)
+#define I_f64data(c) ((double *) I_numdata(c))
+#define I_s64data(c) ((int64_t *) I_numdata(c))
+#define I_u8data(c) ((uint8_t *) I_numdata(c))
+#define I_hashslots(c) (&IX(hashtable, c)->slots)
+#define I_hasholdslots(c) (&IX(hashtable, c)->oldslots)
+#define I_hashmigrated(c) (IX(hashtable, c)->migrated)
+#define I_hashcap(c) (IX(hashtable, c)->slots.cap)
+#define I_hashplaced(c) (IX(hashtable, c)->placed)
+#define I_hashfill(c) (IX(hashtable, c)->buflen)
+#define I_weakness(c) (IX(hashtable, c)->weakness)
+#define I_hashshards(c) (IX(hashtable, c)->shards)
+#define I_cellvalue(c) (IX(cell, c)->cellvalue)
+#define I_modulename(c) (IX(module, c)->modulename)
+#define I_modulemembers(c) (IX(module, c)->modulemembers)
+#define I_cfunc(c) (IX(func, c)->cfunc)
+#define I_bytecode(c) (IX(func, c)->bytecode)
+#define I_funcrefs(c) (IX(func, c)->funcrefs)
+#define I_nlocals(c) (IX(func, c)->nlocals)
+#define I_nargs(c) (IX(func, c)->nargs)
+#define I_variadic(c) (IX(func, c)->variadic)
+#define I_framefunc(c) (IX(frame, c)->framefunc)
+#define I_framestack(c) (IX(frame, c)->framestack)
+#define I_parentframe(c) (IX(frame, c)->parentframe)
 
 // Module with builtin functions and variables
 extern grim_object grim_builtin_module;
@@ -179,7 +293,64 @@ extern grim_object gs_i_moduleset;
 
 extern size_t grim_fixnum_max_ndigits[];
 
-grim_object grim_indirect_create(bool permanent);
+// Layouts of heap blocks, telling the collector which words may hold
+// pointers.  Mixed layouts are described precisely in alloc.c.
+typedef enum {
+    GRIM_LAYOUT_CONSERVATIVE,   // Any word may be a pointer
+    GRIM_LAYOUT_CONS,           // grim_icons
+    GRIM_LAYOUT_ATOMIC,         // No pointers
+    GRIM_LAYOUT_IMMORTAL,       // No pointers into the heap, never collected
+    GRIM_LAYOUT_BOXED,          // Tag and one pointer, followed by data
+    GRIM_LAYOUT_BIGINT,         // grim_ibigint
+    GRIM_LAYOUT_RATIONAL,       // grim_irational
+    GRIM_LAYOUT_HASHTABLE,      // grim_ihashtable
+    GRIM_NLAYOUTS,
+} grim_layout_t;
+
+// Without GRIM_GMP_GC, limbs live on the malloc heap, so there is
+// nothing for the collector to follow in a number
+#ifdef GRIM_GMP_GC
+#define GRIM_LAYOUT_MPZ GRIM_LAYOUT_BIGINT
+#define GRIM_LAYOUT_MPQ GRIM_LAYOUT_RATIONAL
+#else
+#define GRIM_LAYOUT_MPZ GRIM_LAYOUT_ATOMIC
+#define GRIM_LAYOUT_MPQ GRIM_LAYOUT_ATOMIC
+#endif
+
+void grim_alloc_init();
+void *grim_alloc(size_t size, grim_layout_t layout);
+grim_object grim_indirect_create(size_t size, grim_layout_t layout);
+void *grim_realloc(void *ptr, size_t oldsize, size_t newsize, grim_layout_t layout);
+void grim_census_immortal(grim_type_t type, size_t size);
+void grim_census_image(const grim_type_stats_t *types);
+
+// Allocation profiler, see profile.c
+extern bool grim_profiling;
+void grim_profile_record(size_t size, int skip);
+
+// Scratch arenas for temporary C data, see alloc.c
+#define GRIM_ARENA_INLINE (256)
+
+typedef struct grim_arena_chunk_t {
+    struct grim_arena_chunk_t *next;
+    size_t size;
+    alignas(GRIM_ALIGN) char data[];
+} grim_arena_chunk;
+
+typedef struct {
+    char *ptr;
+    char *end;
+    grim_arena_chunk *chunks;
+    alignas(GRIM_ALIGN) char inline_buf[GRIM_ARENA_INLINE];
+} grim_arena;
+
+void grim_arena_init(grim_arena *arena);
+void *grim_arena_alloc(grim_arena *arena, size_t size);
+void grim_arena_reset(grim_arena *arena);
+void grim_arena_free(grim_arena *arena);
+
+grim_object grim_integer_parse(grim_arena *scratch, const char *str, size_t len, int base);
+grim_object grim_float_parse(grim_arena *scratch, const char *str, size_t len);
 
 grim_tag_t grim_direct_tag(grim_object obj);
 
@@ -187,6 +358,10 @@ void grim_buffer_dump(FILE *stream, grim_object obj);
 void grim_buffer_ensure_free_capacity(grim_object obj, size_t sizehint);
 void grim_buffer_copy(grim_object obj, const char *data, size_t length);
 
+void grim_hashtable_ctrl_init(int8_t *ctrl, size_t cap);
+size_t grim_hashtable_place(int8_t *ctrl, size_t cap, uint64_t hash);
+void grim_hashtable_rehash(grim_object table);
+
 void grim_encode_display(grim_object buf, grim_object src, const char *encoding);
 void grim_encode_print(grim_object buf, grim_object src, const char *encoding);
 
@@ -200,12 +375,54 @@ void grim_print_character(grim_object buf, grim_object src, const char *encoding
 void grim_print_string(grim_object buf, grim_object src, const char *encoding);
 
 uint64_t grim_hash(grim_object obj, uint64_t h);
-
+uint64_t grim_hash_bytes(const char *buf, size_t len, uint64_t h);
+
+// Direct objects other than conses are equal only to themselves, so
+// they're hashed by their bits, with a multiply and a shift
+#define GRIM_HASHED_BY_IDENTITY(obj) \
+    (((obj) & 0x0f) != GRIM_INDIRECT_TAG && ((obj) & 0x0f) != GRIM_CONS_TAG)
+
+// So are some indirect objects, which are hashed by address.  Anything
+// else is hashed by what it holds.
+static inline bool grim_hashed_by_address(grim_object obj) {
+    if ((obj & 0x0f) != GRIM_INDIRECT_TAG)
+        return false;
+    switch (I_tag(obj)) {
+    case GRIM_HASHTABLE_TAG:
+    case GRIM_CELL_TAG:
+    case GRIM_MODULE_TAG:
+    case GRIM_CFUNC_TAG:
+    case GRIM_LFUNC_TAG:
+    case GRIM_FRAME_TAG:
+        return true;
+    default:
+        return false;
+    }
+}
+
+static inline uint64_t grim_hash_identity(grim_object obj, uint64_t h) {
+    uint64_t x = (obj ^ h) * 0x9e3779b97f4a7c15;
+    return x ^ (x >> 32);
+}
+
+void grim_symbols_init();
+grim_isymbol **grim_symbols_table(size_t *cap, size_t *fill);
+void grim_symbols_adopt(grim_isymbol *const *buckets, size_t cap, size_t fill);
+grim_isymbol *grim_symbols_merge(grim_isymbol *sym);
+
+grim_object grim_image_open(const char *path, bool fresh);
+
+void grim_gmp_init();
+void grim_gmp_profile(bool on);
 double grim_to_double(grim_object num);
 grim_object grim_negate_i(grim_object obj);
 grim_object grim_scinot_pack(grim_object scale, int base, intmax_t exponent, bool exact);
 bool grim_is_exact(grim_object num);
 grim_object grim_add(grim_object a, grim_object b, bool negate);
+grim_object grim_mpz_pack(mpz_t src);
+
+size_t grim_numvector_eltsize(grim_tag_t tag);
+grim_object grim_numvector_create(grim_tag_t tag, size_t nelems);
 grim_object grim_read_file(FILE *file);
 
 grim_object grim_module_cell(grim_object module, grim_object name, bool require);
@@ -223,7 +440,10 @@ grim_object grim_call_2(grim_object func, grim_object arg1, grim_object arg2);
 // Builtin functions
 // -----------------------------------------------------------------------------
 
-grim_cfunc gf_add, gf_sub;
+grim_cfunc gf_add, gf_sub, gf_vector_copy, gf_vector_fill, gf_heap_stats;
+grim_cfunc gf_numvector_add, gf_numvector_mul, gf_numvector_sum;
+grim_cfunc gf_numvector_dot, gf_numvector_min, gf_numvector_max;
+grim_cfunc gf_hashtable_for_each, gf_hashtable_map;
 
 
 // Bytecode
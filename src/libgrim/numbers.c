@@ -51,20 +51,132 @@ size_t grim_fixnum_max_ndigits[] = {
 };
 
 
+// GMP memory
+// -----------------------------------------------------------------------------
+
+#ifdef GRIM_GMP_GC
+
+// Limbs never contain pointers, so they can be atomic.  The collector
+// reclaims them together with the bignum that points to them, which
+// means bignums don't need finalizers.  Going through the allocator
+// also lets the profiler see them.
+
+static void *grim_gmp_alloc(size_t size) {
+    return grim_alloc(size, GRIM_LAYOUT_ATOMIC);
+}
+
+static void *grim_gmp_realloc(void *ptr, size_t oldsize, size_t newsize) {
+    return grim_realloc(ptr, oldsize, newsize, GRIM_LAYOUT_ATOMIC);
+}
+
+static void grim_gmp_free(void *ptr, size_t size) {
+    (void)size;
+    GC_FREE(ptr);
+}
+
+#else
+
+// Limbs come from GMP's own allocator, which the profiler can't see.
+// While profiling, it's wrapped in functions that record what it
+// allocates and hand everything on, so limbs may be allocated on one
+// side of a profile and freed on the other.
+
+static bool grim_gmp_wrapped;
+static void *(*grim_gmp_next_alloc)(size_t);
+static void *(*grim_gmp_next_realloc)(void *, size_t, size_t);
+static void (*grim_gmp_next_free)(void *, size_t);
+
+static void *grim_gmp_alloc(size_t size) {
+    if (grim_profiling)
+        grim_profile_record(size, 2);
+    return grim_gmp_next_alloc(size);
+}
+
+static void *grim_gmp_realloc(void *ptr, size_t oldsize, size_t newsize) {
+    if (grim_profiling)
+        grim_profile_record(newsize, 2);
+    return grim_gmp_next_realloc(ptr, oldsize, newsize);
+}
+
+#endif
+
+void grim_gmp_init() {
+#ifdef GRIM_GMP_GC
+    mp_set_memory_functions(grim_gmp_alloc, grim_gmp_realloc, grim_gmp_free);
+#endif
+}
+
+// Called as profiling starts and stops.  With GRIM_GMP_GC, limbs go
+// through grim_alloc, which records them already.
+void grim_gmp_profile(bool on) {
+#ifndef GRIM_GMP_GC
+    if (on == grim_gmp_wrapped)
+        return;
+    if (on) {
+        mp_get_memory_functions(&grim_gmp_next_alloc, &grim_gmp_next_realloc, &grim_gmp_next_free);
+        mp_set_memory_functions(grim_gmp_alloc, grim_gmp_realloc, grim_gmp_next_free);
+    }
+    else
+        mp_set_memory_functions(grim_gmp_next_alloc, grim_gmp_next_realloc, grim_gmp_next_free);
+    grim_gmp_wrapped = on;
+#else
+    (void)on;
+#endif
+}
+
+
 // Floats
 // -----------------------------------------------------------------------------
 
+static inline uint64_t rotate_left(uint64_t n, int k) {
+    return (n << k) | (n >> (64 - k));
+}
+
+static inline uint64_t rotate_right(uint64_t n, int k) {
+    return (n >> k) | (n << (64 - k));
+}
+
 grim_object grim_float_pack(double num) {
-    grim_object obj = grim_indirect_create(false);
+    uint64_t bits;
+    memcpy(&bits, &num, sizeof(bits));
+
+    // Rotate the sign and the top four exponent bits down to the tag
+    // position, then drop the four that are implied by the fifth
+    uint64_t top = (bits >> 58) & 0x1f;
+    if (top == 0x0f || top == 0x10) {
+        grim_object obj = (rotate_left(bits, 5) & ~(grim_object) 0x0f) | GRIM_FLONUM_TAG;
+        if (obj != GRIM_FLONUM_ZERO)
+            return obj;
+    }
+    else if (bits == 0)
+        return GRIM_FLONUM_ZERO;
+
+    grim_object obj = grim_indirect_create(sizeof(grim_ifloat), GRIM_LAYOUT_ATOMIC);
+    I_tag(obj) = GRIM_FLOAT_TAG;
     I_floating(obj) = num;
     return obj;
 }
 
-grim_object grim_float_read(const char *str) {
-    // Scanf understands a subset of our syntax:
+double grim_float_extract(grim_object obj) {
+    if (grim_direct_tag(obj) == GRIM_INDIRECT_TAG)
+        return I_floating(obj);
+    if (obj == GRIM_FLONUM_ZERO)
+        return 0.0;
+
+    uint64_t bits = obj & ~(grim_object) 0x0f;
+    bits |= (obj >> 63) ? 0x07 : 0x08;
+    bits = rotate_right(bits, 5);
+
+    double num;
+    memcpy(&num, &bits, sizeof(num));
+    return num;
+}
+
+grim_object grim_float_parse(grim_arena *scratch, const char *str, size_t len) {
+    // Strtod understands a subset of our syntax:
     // Normalize zero digits and ignorable characters
-    char *dup = strdup(str), *tgt = dup;
-    for (char *src = dup; *src; src++) {
+    char *dup = grim_arena_alloc(scratch, len + 1), *tgt = dup;
+    for (const char *src = str; src < str + len; src++) {
         if (*src == '_')
             continue;
         if (*src == '#')
@@ -75,22 +187,30 @@ grim_object grim_float_read(const char *str) {
     }
     *tgt = 0;
 
-    double value;
-    sscanf(dup, "%lf", &value);
-    free(dup);
+    return grim_float_pack(strtod(dup, NULL));
+}
 
-    return grim_float_pack(value);
+grim_object grim_nfloat_read(const char *str, size_t len) {
+    grim_arena scratch;
+    grim_arena_init(&scratch);
+    grim_object retval = grim_float_parse(&scratch, str, len);
+    grim_arena_free(&scratch);
+    return retval;
+}
+
+grim_object grim_float_read(const char *str) {
+    return grim_nfloat_read(str, strlen(str));
 }
 
 double grim_to_double(grim_object num) {
     if (grim_direct_tag(num) == GRIM_FIXNUM_TAG)
         return grim_integer_extract(num);
     else if (grim_type(num) == GRIM_FLOAT)
-        return I_floating(num);
+        return grim_float_extract(num);
     else if (grim_type(num) == GRIM_INTEGER)
-        return mpz_get_d(I(num)->bigint);
+        return mpz_get_d(I_bigint(num));
     else if (grim_type(num) == GRIM_RATIONAL)
-        return mpq_get_d(I(num)->rational);
+        return mpq_get_d(I_rational(num));
     assert(false);
 }
 
@@ -98,16 +218,20 @@ double grim_to_double(grim_object num) {
 // Integers
 // -----------------------------------------------------------------------------
 
+#ifndef GRIM_GMP_GC
 static void grim_bigint_finalize(void *obj, void *_) {
     (void)_;
-    mpz_clear(I(obj)->bigint);
+    mpz_clear(I_bigint(obj));
 }
+#endif
 
 grim_object grim_bigint_create() {
-    grim_object obj = grim_indirect_create(false);
+    grim_object obj = grim_indirect_create(sizeof(grim_ibigint), GRIM_LAYOUT_MPZ);
     I_tag(obj) = GRIM_BIGINT_TAG;
     mpz_init(I_bigint(obj));
+#ifndef GRIM_GMP_GC
     GC_REGISTER_FINALIZER((void*)obj, grim_bigint_finalize, NULL, NULL, NULL);
+#endif
     return obj;
 }
 
@@ -142,13 +266,11 @@ static grim_object grim_integer_normalize(grim_object obj) {
     return obj;
 }
 
-grim_object grim_integer_read(const char *str, int base) {
-    size_t len = strlen(str);
-
+grim_object grim_integer_parse(grim_arena *scratch, const char *str, size_t len, int base) {
     if (len <= grim_fixnum_max_ndigits[base]) {
         intmax_t value = 0;
-        for (; *str; str++) {
-            int digit = DIGIT_VALUE[(int) *str];
+        for (const char *src = str; src < str + len; src++) {
+            int digit = DIGIT_VALUE[(int) *src];
             if (digit == IGNORE)
                 continue;
             value = base * value + digit;
@@ -158,8 +280,8 @@ grim_object grim_integer_read(const char *str, int base) {
 
     // GMP understands a subset of our syntax:
     // Normalize zero digits and ignorable characters
-    char *dup = strdup(str), *tgt = dup;
-    for (char *src = dup; *src; src++) {
+    char *dup = grim_arena_alloc(scratch, len + 1), *tgt = dup;
+    for (const char *src = str; src < str + len; src++) {
         int digit = DIGIT_VALUE[(int) *src];
         if (digit == IGNORE)
             continue;
@@ -173,11 +295,22 @@ grim_object grim_integer_read(const char *str, int base) {
 
     grim_object obj = grim_bigint_create();
     assert(!mpz_set_str(I_bigint(obj), dup, base));
-    free(dup);
 
     return grim_integer_normalize(obj);
 }
 
+grim_object grim_ninteger_read(const char *str, size_t len, int base) {
+    grim_arena scratch;
+    grim_arena_init(&scratch);
+    grim_object retval = grim_integer_parse(&scratch, str, len, base);
+    grim_arena_free(&scratch);
+    return retval;
+}
+
+grim_object grim_integer_read(const char *str, int base) {
+    return grim_ninteger_read(str, strlen(str), base);
+}
+
 static void grim_integer_to_mpz(mpz_t tgt, grim_object obj) {
     if (grim_direct_tag(obj) == GRIM_FIXNUM_TAG)
         mpz_set_si(tgt, grim_integer_extract(obj));
@@ -185,7 +318,7 @@ static void grim_integer_to_mpz(mpz_t tgt, grim_object obj) {
         mpz_set(tgt, I_bigint(obj));
 }
 
-static grim_object grim_mpz_to_integer(mpz_t src) {
+grim_object grim_mpz_pack(mpz_t src) {
     if (mpz_fits_slong_p(src))
         return grim_integer_pack(mpz_get_si(src));
     grim_object obj = grim_bigint_create();
@@ -197,16 +330,20 @@ static grim_object grim_mpz_to_integer(mpz_t src) {
 // Rationals
 // -----------------------------------------------------------------------------
 
+#ifndef GRIM_GMP_GC
 static void grim_rational_finalize(void *obj, void *_) {
     (void)_;
     mpq_clear(I_rational(obj));
 }
+#endif
 
 static grim_object grim_rational_create() {
-    grim_object obj = grim_indirect_create(false);
+    grim_object obj = grim_indirect_create(sizeof(grim_irational), GRIM_LAYOUT_MPQ);
     I_tag(obj) = GRIM_RATIONAL_TAG;
     mpq_init(I_rational(obj));
+#ifndef GRIM_GMP_GC
     GC_REGISTER_FINALIZER((void*) obj, grim_rational_finalize, NULL, NULL, NULL);
+#endif
     return obj;
 }
 
@@ -241,16 +378,16 @@ grim_object grim_rational_pack(grim_object numerator, grim_object denominator) {
     mpq_clear(denom);
 
     if (!mpz_cmp_ui(mpq_denref(I_rational(obj)), 1))
-        return grim_mpz_to_integer(mpq_numref(I_rational(obj)));
+        return grim_mpz_pack(mpq_numref(I_rational(obj)));
     return obj;
 }
 
 grim_object grim_rational_num(grim_object obj) {
-    return grim_mpz_to_integer(mpq_numref(I_rational(obj)));
+    return grim_mpz_pack(mpq_numref(I_rational(obj)));
 }
 
 grim_object grim_rational_den(grim_object obj) {
-    return grim_mpz_to_integer(mpq_denref(I_rational(obj)));
+    return grim_mpz_pack(mpq_denref(I_rational(obj)));
 }
 
 
@@ -263,7 +400,7 @@ grim_object grim_complex_pack(grim_object real, grim_object imag) {
         grim_integer_extract(imag) == 0)
         return real;
 
-    if (grim_type(imag) == GRIM_FLOAT && I_floating(imag) == 0.0)
+    if (grim_type(imag) == GRIM_FLOAT && grim_float_extract(imag) == 0.0)
         return real;
 
     if (grim_type(real) == GRIM_FLOAT && grim_type(imag) != GRIM_FLOAT)
@@ -271,7 +408,7 @@ grim_object grim_complex_pack(grim_object real, grim_object imag) {
     else if (grim_type(imag) == GRIM_FLOAT && grim_type(real) != GRIM_FLOAT)
         real = grim_float_pack(grim_to_double(real));
 
-    grim_object obj = grim_indirect_create(false);
+    grim_object obj = grim_indirect_create(sizeof(grim_icomplex), GRIM_LAYOUT_CONSERVATIVE);
     I_tag(obj) = GRIM_COMPLEX_TAG;
     I_real(obj) = real;
     I_imag(obj) = imag;
@@ -295,7 +432,7 @@ bool grim_nonnegative(grim_object obj) {
         return mpq_sgn(I_rational(obj)) >= 0;
 
     if (type == GRIM_FLOAT)
-        return I_floating(obj) >= 0.0;
+        return grim_float_extract(obj) >= 0.0;
 
     assert(false);
 }
@@ -304,10 +441,12 @@ grim_object grim_negate_i(grim_object obj) {
     if (grim_direct_tag(obj) == GRIM_FIXNUM_TAG)
         return grim_integer_pack(-grim_integer_extract(obj));
 
+    // Floats may be immediate, so they can't be negated in place
     grim_type_t type = grim_type(obj);
     if (type == GRIM_FLOAT)
-        I_floating(obj) = -I_floating(obj);
-    else if (type == GRIM_INTEGER)
+        return grim_float_pack(-grim_float_extract(obj));
+
+    if (type == GRIM_INTEGER)
         mpz_neg(I_bigint(obj), I_bigint(obj));
     else if (type == GRIM_RATIONAL)
         mpq_neg(I_rational(obj), I_rational(obj));
@@ -336,7 +475,7 @@ grim_object grim_scinot_pack(grim_object scale, int base, intmax_t exp, bool exa
 
     if (exp < 0) {
         mpz_pow_ui(temp, temp, -exp);
-        retval = grim_rational_pack(scale, grim_mpz_to_integer(temp));
+        retval = grim_rational_pack(scale, grim_mpz_pack(temp));
     }
     else {
         mpz_pow_ui(temp, temp, exp);
@@ -349,7 +488,7 @@ grim_object grim_scinot_pack(grim_object scale, int base, intmax_t exp, bool exa
             mpz_mul(temp, temp, s);
             mpz_clear(s);
         }
-        retval = grim_mpz_to_integer(temp);
+        retval = grim_mpz_pack(temp);
     }
 
     mpz_clear(temp);
@@ -369,6 +508,11 @@ bool grim_is_exact(grim_object num) {
 
 
 grim_object grim_add(grim_object a, grim_object b, bool negate) {
+    if (grim_direct_tag(a) == GRIM_FLONUM_TAG && grim_direct_tag(b) == GRIM_FLONUM_TAG) {
+        double fa = grim_float_extract(a), fb = grim_float_extract(b);
+        return grim_float_pack(negate ? fa - fb : fa + fb);
+    }
+
     grim_type_t ta = grim_type(a), tb = grim_type(b);
     switch (ta) {
     case GRIM_COMPLEX: switch(tb) {
@@ -387,12 +531,12 @@ grim_object grim_add(grim_object a, grim_object b, bool negate) {
         case GRIM_COMPLEX:
             return grim_complex_pack(grim_add(a, I_real(b), negate), I_imag(b));
         case GRIM_FLOAT:
-            return grim_float_pack(negate ? I_floating(a) - I_floating(b)
-                                          : I_floating(a) + I_floating(b));
+            return grim_float_pack(negate ? grim_float_extract(a) - grim_float_extract(b)
+                                          : grim_float_extract(a) + grim_float_extract(b));
         case GRIM_RATIONAL:
         case GRIM_INTEGER:
-            return grim_float_pack(negate ? I_floating(a) - grim_to_double(b)
-                                          : I_floating(a) + grim_to_double(b));
+            return grim_float_pack(negate ? grim_float_extract(a) - grim_to_double(b)
+                                          : grim_float_extract(a) + grim_to_double(b));
         default:
             return grim_undefined;
         }
@@ -401,8 +545,8 @@ grim_object grim_add(grim_object a, grim_object b, bool negate) {
         case GRIM_COMPLEX:
             return grim_complex_pack(grim_add(a, I_real(b), negate), I_imag(b));
         case GRIM_FLOAT:
-            return grim_float_pack(negate ? grim_to_double(a) - I_floating(b)
-                                          : grim_to_double(a) + I_floating(b));
+            return grim_float_pack(negate ? grim_to_double(a) - grim_float_extract(b)
+                                          : grim_to_double(a) + grim_float_extract(b));
         case GRIM_RATIONAL: {
             // TODO: grim_rational_normalize
             grim_object retval = grim_rational_create();
@@ -414,14 +558,14 @@ grim_object grim_add(grim_object a, grim_object b, bool negate) {
         }
         case GRIM_INTEGER: {
             grim_object retval = grim_rational_create();
-            if (grim_integer_extractable(a))
-                mpq_set_si(I_rational(retval), grim_integer_extract(a), 1);
+            if (grim_integer_extractable(b))
+                mpq_set_si(I_rational(retval), grim_integer_extract(b), 1);
             else
-                mpq_set_z(I_rational(retval), I_bigint(a));
+                mpq_set_z(I_rational(retval), I_bigint(b));
             if (negate)
-                mpq_sub(I_rational(retval), I_rational(retval), I_rational(b));
+                mpq_sub(I_rational(retval), I_rational(a), I_rational(retval));
             else
-                mpq_add(I_rational(retval), I_rational(retval), I_rational(b));
+                mpq_add(I_rational(retval), I_rational(a), I_rational(retval));
             return retval;
         }
         default:
@@ -432,17 +576,18 @@ grim_object grim_add(grim_object a, grim_object b, bool negate) {
         case GRIM_COMPLEX:
             return grim_complex_pack(grim_add(a, I_real(b), negate), I_imag(b));
         case GRIM_FLOAT:
-            return grim_float_pack(negate ? grim_to_double(a) - I_floating(b)
-                                          : grim_to_double(a) + I_floating(b));
+            return grim_float_pack(negate ? grim_to_double(a) - grim_float_extract(b)
+                                          : grim_to_double(a) + grim_float_extract(b));
         case GRIM_RATIONAL: {
             grim_object retval = grim_rational_create();
-            if (grim_integer_extractable(b))
-                mpq_set_si(I_rational(retval), grim_integer_extract(b), 1);
+            if (grim_integer_extractable(a))
+                mpq_set_si(I_rational(retval), grim_integer_extract(a), 1);
             else
-                mpq_set_z(I_rational(retval), I_bigint(b));
+                mpq_set_z(I_rational(retval), I_bigint(a));
             if (negate)
-                mpq_neg(I_rational(retval), I_rational(retval));
-            mpq_add(I_rational(retval), I_rational(retval), I_rational(a));
+                mpq_sub(I_rational(retval), I_rational(retval), I_rational(b));
+            else
+                mpq_add(I_rational(retval), I_rational(retval), I_rational(b));
             return retval;
         }
         case GRIM_INTEGER: {
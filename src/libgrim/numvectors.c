@@ -0,0 +1,508 @@
+#include <assert.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "gmp.h"
+
+#include "grim.h"
+#include "internal.h"
+
+
+// Kernels
+// -----------------------------------------------------------------------------
+
+// The kernels work on 32-byte vectors with the compiler's vector
+// extensions, and finish the tail of each array one element at a time.
+// On x86-64, each kernel is compiled twice, for AVX2 and for the
+// baseline (SSE2, where each vector takes two registers), and the
+// loader picks one by what the processor supports.  Elsewhere the
+// compiler lowers the vectors to whatever it has, down to scalars.
+//
+// Reductions keep one accumulator per lane and combine them at the
+// end, in the same order on every target, so floating point sums come
+// out the same everywhere, if not quite the same as a sequential sum.
+
+#if defined(__x86_64__) && defined(__GNUC__)
+#define GRIM_KERNEL __attribute__((target_clones("avx2", "default")))
+#else
+#define GRIM_KERNEL
+#endif
+
+#define GRIM_KERNEL_BYTES (32)
+
+typedef double f64x4 __attribute__((vector_size(GRIM_KERNEL_BYTES)));
+typedef int64_t s64x4 __attribute__((vector_size(GRIM_KERNEL_BYTES)));
+typedef uint64_t u64x4 __attribute__((vector_size(GRIM_KERNEL_BYTES)));
+typedef uint32_t u32x8 __attribute__((vector_size(GRIM_KERNEL_BYTES)));
+typedef uint16_t u16x16 __attribute__((vector_size(GRIM_KERNEL_BYTES)));
+typedef uint8_t u8x32 __attribute__((vector_size(GRIM_KERNEL_BYTES)));
+typedef uint8_t u8x16 __attribute__((vector_size(GRIM_KERNEL_BYTES / 2)));
+typedef uint8_t u8x8 __attribute__((vector_size(GRIM_KERNEL_BYTES / 4)));
+
+// Unaligned loads and stores
+#define LOAD(v, p) memcpy(&(v), (p), sizeof(v))
+#define STORE(p, v) memcpy((p), &(v), sizeof(v))
+
+// Lane-wise select, where mask lanes are all ones or all zeros
+#define SELECT(t, mask, a, b) ((t) (((u64x4) (mask) & (u64x4) (a)) | (~(u64x4) (mask) & (u64x4) (b))))
+
+GRIM_KERNEL
+static void f64_add(double *dest, const double *a, const double *b, size_t n) {
+    size_t i = 0;
+    for (; i + 4 <= n; i += 4) {
+        f64x4 x, y;
+        LOAD(x, a + i);
+        LOAD(y, b + i);
+        x += y;
+        STORE(dest + i, x);
+    }
+    for (; i < n; i++)
+        dest[i] = a[i] + b[i];
+}
+
+GRIM_KERNEL
+static void f64_mul(double *dest, const double *a, const double *b, size_t n) {
+    size_t i = 0;
+    for (; i + 4 <= n; i += 4) {
+        f64x4 x, y;
+        LOAD(x, a + i);
+        LOAD(y, b + i);
+        x *= y;
+        STORE(dest + i, x);
+    }
+    for (; i < n; i++)
+        dest[i] = a[i] * b[i];
+}
+
+GRIM_KERNEL
+static double f64_sum(const double *a, size_t n) {
+    f64x4 acc = {0};
+    size_t i = 0;
+    for (; i + 4 <= n; i += 4) {
+        f64x4 x;
+        LOAD(x, a + i);
+        acc += x;
+    }
+    double sum = (acc[0] + acc[1]) + (acc[2] + acc[3]);
+    for (; i < n; i++)
+        sum += a[i];
+    return sum;
+}
+
+GRIM_KERNEL
+static double f64_dot(const double *a, const double *b, size_t n) {
+    f64x4 acc = {0};
+    size_t i = 0;
+    for (; i + 4 <= n; i += 4) {
+        f64x4 x, y;
+        LOAD(x, a + i);
+        LOAD(y, b + i);
+        acc += x * y;
+    }
+    double sum = (acc[0] + acc[1]) + (acc[2] + acc[3]);
+    for (; i < n; i++)
+        sum += a[i] * b[i];
+    return sum;
+}
+
+// Minimum if max is false, otherwise maximum.  With NaNs, the result
+// is unspecified.
+GRIM_KERNEL
+static double f64_extremum(const double *a, size_t n, bool max) {
+    double best = a[0];
+    size_t i = 0;
+    if (n >= 4) {
+        f64x4 acc;
+        LOAD(acc, a);
+        for (i = 4; i + 4 <= n; i += 4) {
+            f64x4 x;
+            LOAD(x, a + i);
+            acc = SELECT(f64x4, max ? x > acc : x < acc, x, acc);
+        }
+        best = acc[0];
+        for (int k = 1; k < 4; k++)
+            if (max ? acc[k] > best : acc[k] < best)
+                best = acc[k];
+    }
+    for (; i < n; i++)
+        if (max ? a[i] > best : a[i] < best)
+            best = a[i];
+    return best;
+}
+
+// Signed integers wrap around, so they're added and multiplied as
+// unsigned, where that is defined
+GRIM_KERNEL
+static void s64_add(int64_t *dest, const int64_t *a, const int64_t *b, size_t n) {
+    size_t i = 0;
+    for (; i + 4 <= n; i += 4) {
+        u64x4 x, y;
+        LOAD(x, a + i);
+        LOAD(y, b + i);
+        x += y;
+        STORE(dest + i, x);
+    }
+    for (; i < n; i++)
+        dest[i] = (int64_t) ((uint64_t) a[i] + (uint64_t) b[i]);
+}
+
+// AVX2 has no 64-bit multiply, so this is as good as the compiler can
+// make it
+GRIM_KERNEL
+static void s64_mul(int64_t *dest, const int64_t *a, const int64_t *b, size_t n) {
+    size_t i = 0;
+    for (; i + 4 <= n; i += 4) {
+        u64x4 x, y;
+        LOAD(x, a + i);
+        LOAD(y, b + i);
+        x *= y;
+        STORE(dest + i, x);
+    }
+    for (; i < n; i++)
+        dest[i] = (int64_t) ((uint64_t) a[i] * (uint64_t) b[i]);
+}
+
+// Sums the high and low 32-bit halves of each element separately, so
+// that neither can overflow, and the exact sum is high * 2^32 + low
+GRIM_KERNEL
+static void s64_sum(const int64_t *a, size_t n, int64_t *high, uint64_t *low) {
+    s64x4 hacc = {0};
+    u64x4 lacc = {0};
+    size_t i = 0;
+    for (; i + 4 <= n; i += 4) {
+        s64x4 x;
+        LOAD(x, a + i);
+        hacc += x >> 32;
+        lacc += (u64x4) x & 0xffffffff;
+    }
+    int64_t h = hacc[0] + hacc[1] + hacc[2] + hacc[3];
+    uint64_t l = lacc[0] + lacc[1] + lacc[2] + lacc[3];
+    for (; i < n; i++) {
+        h += a[i] >> 32;
+        l += (uint64_t) a[i] & 0xffffffff;
+    }
+    *high = h;
+    *low = l;
+}
+
+GRIM_KERNEL
+static int64_t s64_extremum(const int64_t *a, size_t n, bool max) {
+    int64_t best = a[0];
+    size_t i = 0;
+    if (n >= 4) {
+        s64x4 acc;
+        LOAD(acc, a);
+        for (i = 4; i + 4 <= n; i += 4) {
+            s64x4 x;
+            LOAD(x, a + i);
+            acc = SELECT(s64x4, max ? x > acc : x < acc, x, acc);
+        }
+        best = acc[0];
+        for (int k = 1; k < 4; k++)
+            if (max ? acc[k] > best : acc[k] < best)
+                best = acc[k];
+    }
+    for (; i < n; i++)
+        if (max ? a[i] > best : a[i] < best)
+            best = a[i];
+    return best;
+}
+
+GRIM_KERNEL
+static void u8_add(uint8_t *dest, const uint8_t *a, const uint8_t *b, size_t n) {
+    size_t i = 0;
+    for (; i + 32 <= n; i += 32) {
+        u8x32 x, y;
+        LOAD(x, a + i);
+        LOAD(y, b + i);
+        x += y;
+        STORE(dest + i, x);
+    }
+    for (; i < n; i++)
+        dest[i] = a[i] + b[i];
+}
+
+GRIM_KERNEL
+static void u8_mul(uint8_t *dest, const uint8_t *a, const uint8_t *b, size_t n) {
+    size_t i = 0;
+    for (; i + 32 <= n; i += 32) {
+        u8x32 x, y;
+        LOAD(x, a + i);
+        LOAD(y, b + i);
+        x *= y;
+        STORE(dest + i, x);
+    }
+    for (; i < n; i++)
+        dest[i] = a[i] * b[i];
+}
+
+// Widens into 16-bit lanes, which are flushed before they can overflow
+GRIM_KERNEL
+static uint64_t u8_sum(const uint8_t *a, size_t n) {
+    uint64_t sum = 0;
+    size_t i = 0;
+    while (i + 32 <= n) {
+        u16x16 acc = {0};
+        for (int k = 0; k < 128 && i + 32 <= n; k++, i += 32) {
+            u8x16 lo, hi;
+            LOAD(lo, a + i);
+            LOAD(hi, a + i + 16);
+            acc += __builtin_convertvector(lo, u16x16) + __builtin_convertvector(hi, u16x16);
+        }
+        for (int k = 0; k < 16; k++)
+            sum += acc[k];
+    }
+    for (; i < n; i++)
+        sum += a[i];
+    return sum;
+}
+
+// Widens into 32-bit lanes, which are flushed before they can overflow
+GRIM_KERNEL
+static uint64_t u8_dot(const uint8_t *a, const uint8_t *b, size_t n) {
+    uint64_t sum = 0;
+    size_t i = 0;
+    while (i + 8 <= n) {
+        u32x8 acc = {0};
+        for (int k = 0; k < 65536 && i + 8 <= n; k++, i += 8) {
+            u8x8 x, y;
+            LOAD(x, a + i);
+            LOAD(y, b + i);
+            acc += __builtin_convertvector(x, u32x8) * __builtin_convertvector(y, u32x8);
+        }
+        for (int k = 0; k < 8; k++)
+            sum += acc[k];
+    }
+    for (; i < n; i++)
+        sum += (uint32_t) a[i] * b[i];
+    return sum;
+}
+
+GRIM_KERNEL
+static uint8_t u8_extremum(const uint8_t *a, size_t n, bool max) {
+    uint8_t best = a[0];
+    size_t i = 0;
+    if (n >= 32) {
+        u8x32 acc;
+        LOAD(acc, a);
+        for (i = 32; i + 32 <= n; i += 32) {
+            u8x32 x;
+            LOAD(x, a + i);
+            acc = SELECT(u8x32, max ? x > acc : x < acc, x, acc);
+        }
+        best = acc[0];
+        for (int k = 1; k < 32; k++)
+            if (max ? acc[k] > best : acc[k] < best)
+                best = acc[k];
+    }
+    for (; i < n; i++)
+        if (max ? a[i] > best : a[i] < best)
+            best = a[i];
+    return best;
+}
+
+
+// Numeric vectors
+// -----------------------------------------------------------------------------
+
+size_t grim_numvector_eltsize(grim_tag_t tag) {
+    switch (tag) {
+    case GRIM_F64VECTOR_TAG: return sizeof(double);
+    case GRIM_S64VECTOR_TAG: return sizeof(int64_t);
+    case GRIM_BYTEVECTOR_TAG: return sizeof(uint8_t);
+    }
+    assert(false);
+    return 0;
+}
+
+static bool grim_is_numvector(grim_object obj) {
+    if (grim_direct_tag(obj) != GRIM_INDIRECT_TAG)
+        return false;
+    grim_tag_t tag = I_tag(obj);
+    return tag == GRIM_F64VECTOR_TAG || tag == GRIM_S64VECTOR_TAG || tag == GRIM_BYTEVECTOR_TAG;
+}
+
+// Elements are zeroed.  The storage is atomic, so the collector never
+// looks at the numbers in it.
+grim_object grim_numvector_create(grim_tag_t tag, size_t nelems) {
+    grim_object obj = grim_indirect_create(sizeof(grim_inumvector), GRIM_LAYOUT_BOXED);
+    I_tag(obj) = tag;
+    I_numlen(obj) = nelems;
+    size_t size = nelems * grim_numvector_eltsize(tag);
+    I_numdata(obj) = size ? grim_alloc(size, GRIM_LAYOUT_ATOMIC) : NULL;
+    if (size)
+        memset(I_numdata(obj), 0, size);
+    return obj;
+}
+
+grim_object grim_f64vector_create(size_t nelems) {
+    return grim_numvector_create(GRIM_F64VECTOR_TAG, nelems);
+}
+
+grim_object grim_s64vector_create(size_t nelems) {
+    return grim_numvector_create(GRIM_S64VECTOR_TAG, nelems);
+}
+
+grim_object grim_bytevector_create(size_t nelems) {
+    return grim_numvector_create(GRIM_BYTEVECTOR_TAG, nelems);
+}
+
+// The exact integer high * 2^shift + low
+static grim_object grim_wide_pack(int64_t high, uint64_t low, int shift) {
+    int64_t shifted, sum;
+    if (shift < 63 && high >= -(INT64_C(1) << (62 - shift)) && high < (INT64_C(1) << (62 - shift))) {
+        shifted = high * (INT64_C(1) << shift);
+        if (low <= INT64_MAX && !__builtin_add_overflow(shifted, (int64_t) low, &sum))
+            return grim_integer_pack(sum);
+    }
+
+    mpz_t num;
+    mpz_init_set_si(num, high);
+    mpz_mul_2exp(num, num, shift);
+    mpz_add_ui(num, num, low);
+    grim_object retval = grim_mpz_pack(num);
+    mpz_clear(num);
+    return retval;
+}
+
+static grim_object grim_int128_pack(__int128 num) {
+    if (num >= INT64_MIN && num <= INT64_MAX)
+        return grim_integer_pack((int64_t) num);
+    return grim_wide_pack((int64_t) (num >> 64), (uint64_t) num, 64);
+}
+
+// Products of 64-bit integers fit in 128 bits, but their sum may not,
+// in which case the rest is summed with GMP
+static grim_object grim_s64_dot(const int64_t *a, const int64_t *b, size_t n) {
+    __int128 sum = 0;
+    size_t i = 0;
+    for (; i < n; i++) {
+        __int128 next;
+        if (__builtin_add_overflow(sum, (__int128) a[i] * b[i], &next))
+            break;
+        sum = next;
+    }
+    if (i == n)
+        return grim_int128_pack(sum);
+
+    mpz_t total, term;
+    mpz_init(total);
+    mpz_init(term);
+    mpz_set_si(total, (int64_t) (sum >> 64));
+    mpz_mul_2exp(total, total, 64);
+    mpz_add_ui(total, total, (uint64_t) sum);
+    for (; i < n; i++) {
+        mpz_set_si(term, a[i]);
+        mpz_mul_si(term, term, b[i]);
+        mpz_add(total, total, term);
+    }
+    grim_object retval = grim_mpz_pack(total);
+    mpz_clear(term);
+    mpz_clear(total);
+    return retval;
+}
+
+static void grim_numvector_check_pair(grim_object a, grim_object b) {
+    assert(grim_is_numvector(a) && grim_is_numvector(b));
+    assert(I_tag(a) == I_tag(b));
+    assert(I_numlen(a) == I_numlen(b));
+}
+
+// Elementwise sum, wrapping around for integers
+grim_object grim_numvector_add(grim_object a, grim_object b) {
+    grim_numvector_check_pair(a, b);
+    size_t n = I_numlen(a);
+    grim_object result = grim_numvector_create(I_tag(a), n);
+    switch (I_tag(a)) {
+    case GRIM_F64VECTOR_TAG:
+        f64_add(I_f64data(result), I_f64data(a), I_f64data(b), n);
+        break;
+    case GRIM_S64VECTOR_TAG:
+        s64_add(I_s64data(result), I_s64data(a), I_s64data(b), n);
+        break;
+    case GRIM_BYTEVECTOR_TAG:
+        u8_add(I_u8data(result), I_u8data(a), I_u8data(b), n);
+        break;
+    }
+    return result;
+}
+
+// Elementwise product, wrapping around for integers
+grim_object grim_numvector_mul(grim_object a, grim_object b) {
+    grim_numvector_check_pair(a, b);
+    size_t n = I_numlen(a);
+    grim_object result = grim_numvector_create(I_tag(a), n);
+    switch (I_tag(a)) {
+    case GRIM_F64VECTOR_TAG:
+        f64_mul(I_f64data(result), I_f64data(a), I_f64data(b), n);
+        break;
+    case GRIM_S64VECTOR_TAG:
+        s64_mul(I_s64data(result), I_s64data(a), I_s64data(b), n);
+        break;
+    case GRIM_BYTEVECTOR_TAG:
+        u8_mul(I_u8data(result), I_u8data(a), I_u8data(b), n);
+        break;
+    }
+    return result;
+}
+
+// Integer sums are exact
+grim_object grim_numvector_sum(grim_object vec) {
+    assert(grim_is_numvector(vec));
+    size_t n = I_numlen(vec);
+    switch (I_tag(vec)) {
+    case GRIM_F64VECTOR_TAG:
+        return grim_float_pack(f64_sum(I_f64data(vec), n));
+    case GRIM_S64VECTOR_TAG:
+    {
+        int64_t high;
+        uint64_t low;
+        s64_sum(I_s64data(vec), n, &high, &low);
+        return grim_wide_pack(high, low, 32);
+    }
+    case GRIM_BYTEVECTOR_TAG:
+        return grim_wide_pack(0, u8_sum(I_u8data(vec), n), 0);
+    }
+    return grim_undefined;
+}
+
+// Integer dot products are exact
+grim_object grim_numvector_dot(grim_object a, grim_object b) {
+    grim_numvector_check_pair(a, b);
+    size_t n = I_numlen(a);
+    switch (I_tag(a)) {
+    case GRIM_F64VECTOR_TAG:
+        return grim_float_pack(f64_dot(I_f64data(a), I_f64data(b), n));
+    case GRIM_S64VECTOR_TAG:
+        return grim_s64_dot(I_s64data(a), I_s64data(b), n);
+    case GRIM_BYTEVECTOR_TAG:
+        return grim_wide_pack(0, u8_dot(I_u8data(a), I_u8data(b), n), 0);
+    }
+    return grim_undefined;
+}
+
+static grim_object grim_numvector_extremum(grim_object vec, bool max) {
+    assert(grim_is_numvector(vec));
+    size_t n = I_numlen(vec);
+    if (n == 0)
+        return grim_undefined;
+    switch (I_tag(vec)) {
+    case GRIM_F64VECTOR_TAG:
+        return grim_float_pack(f64_extremum(I_f64data(vec), n, max));
+    case GRIM_S64VECTOR_TAG:
+        return grim_integer_pack(s64_extremum(I_s64data(vec), n, max));
+    case GRIM_BYTEVECTOR_TAG:
+        return grim_integer_pack(u8_extremum(I_u8data(vec), n, max));
+    }
+    return grim_undefined;
+}
+
+// Undefined for empty vectors
+grim_object grim_numvector_min(grim_object vec) {
+    return grim_numvector_extremum(vec, false);
+}
+
+grim_object grim_numvector_max(grim_object vec) {
+    return grim_numvector_extremum(vec, true);
+}
@@ -4,6 +4,10 @@
 #include <stdlib.h>
 #include <string.h>
 
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
 #include "gc.h"
 #include "gmp.h"
 #include "uniconv.h"
@@ -12,12 +16,11 @@
 #include "internal.h"
 
 
-grim_object grim_symbol_table;
-
-
 grim_tag_t grim_direct_tag(grim_object obj) {
     if ((obj & GRIM_FIXNUM_TAG) != 0)
         return GRIM_FIXNUM_TAG;
+    if ((obj & 0x0f) == GRIM_SPECIAL_TAG)
+        return obj & 0xff;
     return obj & 0x0f;
 }
 
@@ -28,6 +31,8 @@ grim_type_t grim_type(grim_object obj) {
     case GRIM_SYMBOL_TAG: return GRIM_SYMBOL;
     case GRIM_FALSE_TAG: case GRIM_TRUE_TAG: return GRIM_BOOLEAN;
     case GRIM_NIL_TAG: return GRIM_NIL;
+    case GRIM_FLONUM_TAG: return GRIM_FLOAT;
+    case GRIM_CONS_TAG: return GRIM_CONS;
     case GRIM_INDIRECT_TAG:
         switch (I_tag(obj)) {
         case GRIM_FLOAT_TAG: return GRIM_FLOAT;
@@ -36,10 +41,12 @@ grim_type_t grim_type(grim_object obj) {
         case GRIM_COMPLEX_TAG: return GRIM_COMPLEX;
         case GRIM_STRING_TAG: return GRIM_STRING;
         case GRIM_VECTOR_TAG: return GRIM_VECTOR;
-        case GRIM_CONS_TAG: return GRIM_CONS;
         case GRIM_BUFFER_TAG: return GRIM_BUFFER;
         case GRIM_HASHTABLE_TAG: return GRIM_HASHTABLE;
         case GRIM_CELL_TAG: return GRIM_CELL;
+        case GRIM_F64VECTOR_TAG: return GRIM_F64VECTOR;
+        case GRIM_S64VECTOR_TAG: return GRIM_S64VECTOR;
+        case GRIM_BYTEVECTOR_TAG: return GRIM_BYTEVECTOR;
         case GRIM_MODULE_TAG: return GRIM_MODULE;
         case GRIM_CFUNC_TAG: case GRIM_LFUNC_TAG: return GRIM_FUNCTION;
         case GRIM_FRAME_TAG: return GRIM_FRAME;
@@ -50,31 +57,24 @@ grim_type_t grim_type(grim_object obj) {
 }
 
 
-grim_object grim_indirect_create(bool permanent) {
-    grim_indirect *retval;
-    if (permanent)
-        retval = GC_MALLOC_UNCOLLECTABLE(sizeof(grim_indirect));
-    else
-        retval = GC_MALLOC(sizeof(grim_indirect));
-    assert(retval);
-    return (grim_object) retval;
-}
-
-
 // Strings
 // -----------------------------------------------------------------------------
 
-static void grim_string_finalize(void *obj, void *_) {
-    (void)_;
-    free(I_str(obj));
-}
-
-static grim_object grim_string_create() {
-    grim_object obj = grim_indirect_create(false);
+static grim_object grim_string_create(size_t length) {
+    grim_object obj;
+    if (length <= GRIM_STRING_INLINE_MAX) {
+        // The only pointer is to the object itself
+        obj = grim_indirect_create(sizeof(grim_istring) + length + 1, GRIM_LAYOUT_ATOMIC);
+        I_str(obj) = IX(string, obj)->sinline;
+    }
+    else {
+        obj = grim_indirect_create(sizeof(grim_istring), GRIM_LAYOUT_BOXED);
+        I_str(obj) = grim_alloc(length + 1, GRIM_LAYOUT_ATOMIC);
+    }
     I_tag(obj) = GRIM_STRING_TAG;
-    I_str(obj) = NULL;
-    I_strlen(obj) = 0;
-    GC_REGISTER_FINALIZER((void*) obj, grim_string_finalize, NULL, NULL, NULL);
+    I_strhash(obj) = 0;
+    I_strlen(obj) = length;
+    I_str(obj)[length] = 0;
     return obj;
 }
 
@@ -83,15 +83,24 @@ grim_object grim_string_pack(const char *input, const char *encoding, bool unesc
 }
 
 grim_object grim_nstring_pack(const char *input, size_t length, const char *encoding, bool unescape) {
-    grim_object obj = grim_string_create();
+    grim_object obj;
     if (!encoding) {
-        I_strlen(obj) = length;
-        I_str(obj) = malloc((I_strlen(obj) + 1) * sizeof(char));
-        strcpy((char *) I_str(obj), input);
+        obj = grim_string_create(length);
+        memcpy(I_str(obj), input, length);
+    }
+    else {
+        // Convert into a local buffer, which is only replaced by a
+        // malloc'd one if the result doesn't fit
+        uint8_t workspace[256];
+        size_t u8len = sizeof(workspace);
+        uint8_t *u8str = u8_conv_from_encoding(
+            encoding, iconveh_error, input, length, NULL, workspace, &u8len);
+        assert(u8str);
+        obj = grim_string_create(u8len);
+        memcpy(I_str(obj), u8str, u8len);
+        if (u8str != workspace)
+            free(u8str);
     }
-    else
-        I_str(obj) = u8_conv_from_encoding(encoding, iconveh_error, input, length, NULL, NULL, &I_strlen(obj));
-    assert(I_str(obj));
     if (unescape)
         grim_unescape_string(obj);
     return obj;
@@ -101,52 +110,65 @@ grim_object grim_nstring_pack(const char *input, size_t length, const char *enco
 // Vectors
 // -----------------------------------------------------------------------------
 
+#define GRIM_VECTOR_MIN_SIZE (8)
+
+// Fills by doubling: each memcpy copies everything filled so far
+static void grim_fill_objects(grim_object *dest, grim_object value, size_t nelems) {
+    if (nelems == 0)
+        return;
+    dest[0] = value;
+    for (size_t done = 1; done < nelems; done *= 2)
+        memcpy(dest + done, dest, (done < nelems - done ? done : nelems - done) * sizeof(grim_object));
+}
+
 grim_object grim_vector_create(size_t nelems) {
-    grim_object obj = grim_indirect_create(false);
+    grim_object obj = grim_indirect_create(sizeof(grim_ivector), GRIM_LAYOUT_BOXED);
     I_tag(obj) = GRIM_VECTOR_TAG;
-    assert((I_vectordata(obj) = GC_MALLOC(nelems * sizeof(grim_object))));
+    I_vectordata(obj) = nelems ? grim_alloc(nelems * sizeof(grim_object), GRIM_LAYOUT_CONSERVATIVE) : NULL;
     I_vectorlen(obj) = nelems;
-    for (size_t i = 0; i < nelems; i++)
-        I_vectordata(obj)[i] = grim_undefined;
+    I_vectorcap(obj) = nelems;
+    grim_fill_objects(I_vectordata(obj), grim_undefined, nelems);
     return obj;
 }
 
+void grim_vector_reserve(grim_object vec, size_t capacity) {
+    if (capacity <= I_vectorcap(vec))
+        return;
+    // The collector clears new memory, and copies only what was there
+    I_vectordata(vec) = grim_realloc(I_vectordata(vec), I_vectorcap(vec) * sizeof(grim_object),
+                                     capacity * sizeof(grim_object), GRIM_LAYOUT_CONSERVATIVE);
+    I_vectorcap(vec) = capacity;
+}
 
-// Cons cells
-// -----------------------------------------------------------------------------
+void grim_vector_push(grim_object vec, grim_object elt) {
+    if (I_vectorlen(vec) == I_vectorcap(vec))
+        grim_vector_reserve(vec, I_vectorcap(vec) ? 2 * I_vectorcap(vec) : GRIM_VECTOR_MIN_SIZE);
+    I_vectorelt(vec, I_vectorlen(vec)++) = elt;
+}
 
-grim_object grim_cons_pack(grim_object car, grim_object cdr) {
-    grim_object obj = grim_indirect_create(false);
-    I_tag(obj) = GRIM_CONS_TAG;
-    I_car(obj) = car;
-    I_cdr(obj) = cdr;
-    return obj;
+void grim_vector_copy(grim_object dest, size_t at, grim_object src, size_t start, size_t end) {
+    assert(start <= end && end <= I_vectorlen(src));
+    assert(at <= I_vectorlen(dest) && end - start <= I_vectorlen(dest) - at);
+    if (end > start)
+        memmove(I_vectordata(dest) + at, I_vectordata(src) + start, (end - start) * sizeof(grim_object));
+}
+
+void grim_vector_fill(grim_object vec, grim_object value, size_t start, size_t end) {
+    assert(start <= end && end <= I_vectorlen(vec));
+    grim_fill_objects(I_vectordata(vec) + start, value, end - start);
 }
 
 
-// Symbols
+// Cons cells
 // -----------------------------------------------------------------------------
 
-static grim_object grim_symbol_create(grim_object name) {
-    grim_object obj = grim_indirect_create(true) | GRIM_SYMBOL_TAG;
-    I_symbolname(obj) = name;
+grim_object grim_cons_pack(grim_object car, grim_object cdr) {
+    grim_object obj = grim_indirect_create(sizeof(grim_icons), GRIM_LAYOUT_CONS) | GRIM_CONS_TAG;
+    I_car(obj) = car;
+    I_cdr(obj) = cdr;
     return obj;
 }
 
-grim_object grim_intern(const char *name, const char *encoding) {
-    return grim_nintern(name, strlen(name), encoding);
-}
-
-grim_object grim_nintern(const char *name, size_t length, const char *encoding) {
-    grim_object str = grim_nstring_pack(name, length, encoding, false);
-    grim_object sym = grim_hashtable_get(grim_symbol_table, str);
-    if (sym != grim_undefined)
-        return sym;
-    sym = grim_symbol_create(str);
-    grim_hashtable_set(grim_symbol_table, str, sym);
-    return sym;
-}
-
 
 // Characters
 // -----------------------------------------------------------------------------
@@ -185,32 +207,26 @@ ucs4_t grim_character_extract(grim_object obj) {
 #define GRIM_BUFFER_GROWTH_FACTOR (1.5)
 #define GRIM_BUFFER_MIN_SIZE (1024)
 
-static void grim_buffer_finalize(void *obj, void *_) {
-    (void)_;
-    free(I_buf(obj));
-}
-
 grim_object grim_buffer_create(size_t sizehint) {
     if (sizehint < GRIM_BUFFER_MIN_SIZE)
         sizehint = GRIM_BUFFER_MIN_SIZE;
-    grim_object obj = grim_indirect_create(false);
+    grim_object obj = grim_indirect_create(sizeof(grim_ibuffer), GRIM_LAYOUT_BOXED);
     I_tag(obj) = GRIM_BUFFER_TAG;
-    assert((I_buf(obj) = malloc(sizehint)));
+    I_buf(obj) = grim_alloc(sizehint, GRIM_LAYOUT_ATOMIC);
     I_buflen(obj) = 0;
     I_bufcap(obj) = sizehint;
-    GC_REGISTER_FINALIZER((void*) obj, grim_buffer_finalize, NULL, NULL, NULL);
     return obj;
 }
 
 void grim_buffer_dump(FILE *stream, grim_object obj) {
-    fprintf(stream, "%*s", (int) I_buflen(obj), I_buf(obj));
+    fwrite(I_buf(obj), 1, I_buflen(obj), stream);
 }
 
 void grim_buffer_ensure_free_capacity(grim_object obj, size_t sizehint) {
     size_t required = I_buflen(obj) + sizehint;
     while (I_bufcap(obj) < required) {
         size_t newsize = (size_t) (I_bufcap(obj) * GRIM_BUFFER_GROWTH_FACTOR);
-        assert((I_buf(obj) = realloc(I_buf(obj), newsize)));
+        I_buf(obj) = grim_realloc(I_buf(obj), I_bufcap(obj), newsize, GRIM_LAYOUT_ATOMIC);
         I_bufcap(obj) = newsize;
     }
 }
@@ -225,97 +241,706 @@ void grim_buffer_copy(grim_object obj, const char *data, size_t length) {
 // Hash tables
 // -----------------------------------------------------------------------------
 
-#define GRIM_HASHTABLE_MAX_FILL (0.9)
-#define GRIM_HASHTABLE_GROWTH_FACTOR (1.5)
-#define GRIM_HASHTABLE_MIN_SIZE (1024)
+// Tables use open addressing, in the style of Abseil's Swiss tables.
+// Each slot has a control byte, which is empty, deleted, or the low
+// seven bits of the hash of the key in it, and the index of its entry.
+// A lookup starts at a slot given by the rest of the hash, and compares
+// sixteen control bytes at a time against the seven bits it has, so
+// that most keys that don't match are never looked at.  The first
+// group of control bytes is repeated after the last one, so that a
+// group can start anywhere.
+//
+// The keys, values and hashes themselves are kept apart from the
+// slots, in the order they were added, as in CPython's compact dicts.
+// Going through a table only looks at its entries, which are most of
+// what it holds, and does it in a predictable order.  Removed entries
+// leave holes, which are left behind when the table is next resized.
+// Every entry added takes up room, whether its slot was deleted before
+// or not, and there's less room than there are slots, so there's
+// always an empty slot to end a probe.
+//
+// Of the keys whose seven bits do match, the one being looked for is
+// usually the very same object, and the others almost always have a
+// different hash, so those are checked before calling grim_equal.
+// Symbols, fixnums and other direct keys but conses can only be the
+// very same object, so they're hashed inline and never get that far.
+// Keeping the hashes also means that a table can grow without hashing
+// its keys again.
+//
+// A table grows a little at a time.  When it runs out of room, it gets
+// new slots, and every change after that moves the next
+// GRIM_HASHTABLE_MIGRATE old entries over, until there are none left.
+// Until then, lookups that miss in the new slots look in the old ones.
+// The new slots have room for at least the old entries and as many
+// again, and they're all moved after at most cap / MIGRATE changes, so
+// the table never runs out of room while it's growing.  The old entries
+// are moved to the front, in order, and the new ones added after them.
+// Moving a few hundred entries at a time costs a few microseconds, and
+// keeps enough of the speed of moving them all at once.
+//
+// Tables smaller than a group, which is how they all start, are
+// searched from end to end instead.  Their control bytes all fit in a
+// single group, so a lookup is one comparison and a look at the keys it
+// picks out.  A table with only a few entries then takes a few hundred
+// bytes in all.
+//
+// Weak references are kept in arrays that the collector doesn't scan,
+// and are registered as disappearing links.  An entry with a cleared
+// reference is deleted when it's next seen.
+
+#define GRIM_HASHTABLE_MIN_SIZE (8)
+#define GRIM_HASHTABLE_MIGRATE (256)
+#define GRIM_HASHTABLE_NONE ((size_t) -1)
+
+#define GRIM_CTRL_EMPTY ((int8_t) -128)
+#define GRIM_CTRL_DELETED ((int8_t) -2)
+
+static_assert(GRIM_HASHTABLE_GROUP % GRIM_HASHTABLE_MIN_SIZE == 0, "");
+
+#ifdef __SSE2__
+
+static inline uint32_t grim_group_match(const int8_t *ctrl, int8_t byte) {
+    __m128i group = _mm_loadu_si128((const __m128i *) ctrl);
+    return _mm_movemask_epi8(_mm_cmpeq_epi8(group, _mm_set1_epi8(byte)));
+}
+
+// Empty and deleted slots are the ones with the sign bit set
+static inline uint32_t grim_group_match_free(const int8_t *ctrl) {
+    return _mm_movemask_epi8(_mm_loadu_si128((const __m128i *) ctrl));
+}
+
+#else
+
+static inline uint32_t grim_group_match(const int8_t *ctrl, int8_t byte) {
+    uint32_t bits = 0;
+    for (int i = 0; i < GRIM_HASHTABLE_GROUP; i++)
+        bits |= (uint32_t) (ctrl[i] == byte) << i;
+    return bits;
+}
+
+static inline uint32_t grim_group_match_free(const int8_t *ctrl) {
+    uint32_t bits = 0;
+    for (int i = 0; i < GRIM_HASHTABLE_GROUP; i++)
+        bits |= (uint32_t) (ctrl[i] < 0) << i;
+    return bits;
+}
+
+#endif
+
+static inline size_t grim_hashtable_start(uint64_t hash, size_t cap) {
+    return (hash >> 7) & (cap - 1);
+}
+
+static inline int8_t grim_hashtable_h2(uint64_t hash) {
+    return hash & 0x7f;
+}
+
+static inline bool grim_hashtable_small(size_t cap) {
+    return cap < GRIM_HASHTABLE_GROUP;
+}
+
+// The slots of a small table, out of a group
+static inline uint32_t grim_hashtable_small_mask(size_t cap) {
+    return ((uint32_t) 1 << cap) - 1;
+}
+
+static inline void grim_hashtable_set_ctrl(int8_t *ctrl, size_t cap, size_t i, int8_t byte) {
+    ctrl[i] = byte;
+    if (i < GRIM_HASHTABLE_GROUP)
+        ctrl[cap + i] = byte;
+}
+
+void grim_hashtable_ctrl_init(int8_t *ctrl, size_t cap) {
+    memset(ctrl, (uint8_t) GRIM_CTRL_EMPTY, cap + GRIM_HASHTABLE_GROUP);
+}
+
+// Finds the first free slot for a hash.  Groups are probed in
+// triangular steps, which visit all of them in a table whose size is a
+// power of two, and there's always a free slot somewhere.
+static size_t grim_hashtable_free_slot(const int8_t *ctrl, size_t cap, uint64_t hash) {
+    if (grim_hashtable_small(cap))
+        return __builtin_ctz(grim_group_match_free(ctrl) & grim_hashtable_small_mask(cap));
+    size_t pos = grim_hashtable_start(hash, cap);
+    for (size_t step = GRIM_HASHTABLE_GROUP;; step += GRIM_HASHTABLE_GROUP) {
+        uint32_t bits = grim_group_match_free(ctrl + pos);
+        if (bits)
+            return (pos + __builtin_ctz(bits)) & (cap - 1);
+        pos = (pos + step) & (cap - 1);
+    }
+}
+
+// Takes a free slot for a hash, in a table without deleted slots
+size_t grim_hashtable_place(int8_t *ctrl, size_t cap, uint64_t hash) {
+    size_t i = grim_hashtable_free_slot(ctrl, cap, hash);
+    grim_hashtable_set_ctrl(ctrl, cap, i, grim_hashtable_h2(hash));
+    return i;
+}
+
+static inline bool grim_hashtable_weak_keys(grim_object table) {
+    return I_weakness(table) == GRIM_WEAK_KEYS || I_weakness(table) == GRIM_WEAK_BOTH;
+}
+
+static inline bool grim_hashtable_weak_values(grim_object table) {
+    return I_weakness(table) == GRIM_WEAK_VALUES || I_weakness(table) == GRIM_WEAK_BOTH;
+}
+
+// Weak references are hidden from the collector in atomic arrays, which
+// it doesn't clear.  They're cleared here, as the room kept for old
+// entries may be left with holes that must not look live.
+static grim_object *grim_hashtable_refs(size_t room, bool weak) {
+    if (!weak)
+        return grim_alloc(room * sizeof(grim_object), GRIM_LAYOUT_CONSERVATIVE);
+    grim_object *refs = grim_alloc(room * sizeof(grim_object), GRIM_LAYOUT_ATOMIC);
+    memset(refs, 0, room * sizeof(grim_object));
+    return refs;
+}
+
+// Gives a table a fresh set of empty slots, of a size that must be a
+// power of two, and room for as many entries as it may hold
+static void grim_hashtable_init(grim_object table, size_t cap) {
+    grim_hashslots *s = I_hashslots(table);
+    size_t room = GRIM_HASHTABLE_MAX_FILL(cap);
+    assert(room <= UINT32_MAX);
+    s->ctrl = grim_alloc(cap + GRIM_HASHTABLE_GROUP, GRIM_LAYOUT_ATOMIC);
+    grim_hashtable_ctrl_init(s->ctrl, cap);
+    s->index = grim_alloc(cap * sizeof(uint32_t), GRIM_LAYOUT_ATOMIC);
+    s->keys = grim_hashtable_refs(room, grim_hashtable_weak_keys(table));
+    s->values = grim_hashtable_refs(room, grim_hashtable_weak_values(table));
+    s->hashes = grim_alloc(room * sizeof(uint64_t), GRIM_LAYOUT_ATOMIC);
+    s->cap = cap;
+    s->used = 0;
+}
 
 grim_object grim_hashtable_create(size_t sizehint) {
-    if (sizehint < GRIM_HASHTABLE_MIN_SIZE)
-        sizehint = GRIM_HASHTABLE_MIN_SIZE;
-    grim_object obj = grim_indirect_create(false);
+    return grim_hashtable_create_weak(sizehint, GRIM_STRONG);
+}
+
+grim_object grim_hashtable_create_weak(size_t sizehint, grim_weakness_t weakness) {
+    size_t cap = GRIM_HASHTABLE_MIN_SIZE;
+    while (GRIM_HASHTABLE_MAX_FILL(cap) < sizehint)
+        cap *= 2;
+    grim_object obj = grim_indirect_create(sizeof(grim_ihashtable), GRIM_LAYOUT_HASHTABLE);
     I_tag(obj) = GRIM_HASHTABLE_TAG;
-    I_hashnodes(obj) = GC_MALLOC(sizehint * sizeof(grim_hashnode *));
-    assert(I_hashnodes(obj));
-    I_hashcap(obj) = sizehint;
+    I_weakness(obj) = weakness;
+    *I_hasholdslots(obj) = (grim_hashslots) {0};
+    I_hashmigrated(obj) = 0;
+    I_hashplaced(obj) = 0;
     I_hashfill(obj) = 0;
-    for (size_t i = 0; i < sizehint; i++)
-        I_hashnodes(obj)[i] = NULL;
+    I_hashshards(obj) = NULL;
+    grim_hashtable_init(obj, cap);
     return obj;
 }
 
-static grim_hashnode **grim_hashtable_node(grim_hashnode **nodes, grim_object key, size_t hash, size_t length, bool create) {
-    size_t index = hash % length;
-    grim_hashnode **node = &nodes[index];
-    while ((*node) && !grim_equal(key, (*node)->key))
-        node = &(*node)->next;
-    if (*node || !create)
-        return node;
-    grim_hashnode *newnode = GC_MALLOC(sizeof(grim_hashnode));
-    newnode->key = key;
-    newnode->value = grim_undefined;
-    newnode->hash = hash;
-    newnode->next = NULL;
-    *node = newnode;
-    return node;
+// Registers a weak reference with the collector, unless it refers to
+// something that is never collected anyway
+static void grim_hashtable_weaken(grim_object *ref) {
+    grim_tag_t tag = grim_direct_tag(*ref);
+    if (tag != GRIM_INDIRECT_TAG && tag != GRIM_CONS_TAG)
+        return;
+    void *base = (void *) (*ref & ~(grim_object) 0x0f);
+    if (GC_base(base) == base)
+        GC_general_register_disappearing_link((void **) ref, base);
+}
+
+// Moves a weak reference along with its entry.  Entries loaded from a
+// heap image have no reference registered yet, so they get one.
+static void grim_hashtable_move_ref(grim_object *from, grim_object *to) {
+    if (GC_move_disappearing_link((void **) from, (void **) to) == GC_NOT_FOUND)
+        grim_hashtable_weaken(to);
+}
+
+// Small tables have no probe sequences to keep intact, so their slots
+// are emptied outright, and the holes at the end of their entries are
+// given back.  That's only done for strong tables that aren't growing,
+// where a hole can't be mistaken for a cleared entry.
+static void grim_hashtable_erase(grim_object table, grim_hashslots *s, size_t i) {
+    size_t e = s->index[i];
+    if (grim_hashtable_weak_keys(table))
+        GC_unregister_disappearing_link((void **) &s->keys[e]);
+    if (grim_hashtable_weak_values(table))
+        GC_unregister_disappearing_link((void **) &s->values[e]);
+    s->keys[e] = 0;
+    s->values[e] = 0;
+    I_hashfill(table)--;
+    if (!grim_hashtable_small(s->cap)) {
+        grim_hashtable_set_ctrl(s->ctrl, s->cap, i, GRIM_CTRL_DELETED);
+        return;
+    }
+    grim_hashtable_set_ctrl(s->ctrl, s->cap, i, GRIM_CTRL_EMPTY);
+    if (I_weakness(table) == GRIM_STRONG && s == I_hashslots(table) && !I_hasholdslots(table)->cap)
+        while (s->used && !s->keys[s->used - 1])
+            s->used--;
+}
+
+// Whether the key of the entry in a slot whose control byte matches is
+// the one being looked for.  Entries before skip have been moved, and
+// are passed over.  In a weak table, if the entry has been cleared,
+// it's deleted.
+static inline bool grim_hashslots_is(grim_object table, grim_hashslots *s, size_t i, size_t skip,
+                                     grim_object key, uint64_t hash) {
+    size_t e = s->index[i];
+    if (e < skip)
+        return false;
+    if (I_weakness(table) != GRIM_STRONG && !GRIM_HASHENTRY_LIVE(s, e)) {
+        grim_hashtable_erase(table, s, i);
+        return false;
+    }
+    grim_object other = s->keys[e];
+    return other == key ||
+        (!GRIM_HASHED_BY_IDENTITY(key) && s->hashes[e] == hash && grim_equal(key, other));
+}
+
+static size_t grim_hashslots_find(grim_object table, grim_hashslots *s, size_t skip,
+                                  grim_object key, uint64_t hash) {
+    int8_t h2 = grim_hashtable_h2(hash);
+    if (grim_hashtable_small(s->cap)) {
+        uint32_t bits = grim_group_match(s->ctrl, h2) & grim_hashtable_small_mask(s->cap);
+        for (; bits; bits &= bits - 1)
+            if (grim_hashslots_is(table, s, __builtin_ctz(bits), skip, key, hash))
+                return __builtin_ctz(bits);
+        return GRIM_HASHTABLE_NONE;
+    }
+
+    size_t pos = grim_hashtable_start(hash, s->cap);
+    for (size_t step = GRIM_HASHTABLE_GROUP;; step += GRIM_HASHTABLE_GROUP) {
+        const int8_t *group = s->ctrl + pos;
+        for (uint32_t bits = grim_group_match(group, h2); bits; bits &= bits - 1) {
+            size_t i = (pos + __builtin_ctz(bits)) & (s->cap - 1);
+            if (grim_hashslots_is(table, s, i, skip, key, hash))
+                return i;
+        }
+        if (grim_group_match(group, GRIM_CTRL_EMPTY))
+            return GRIM_HASHTABLE_NONE;
+        pos = (pos + step) & (s->cap - 1);
+    }
+}
+
+// Finds the slot of a key, in the new slots or the old ones
+static size_t grim_hashtable_find(grim_object table, grim_object key, uint64_t hash, grim_hashslots **s) {
+    *s = I_hashslots(table);
+    size_t i = grim_hashslots_find(table, *s, 0, key, hash);
+    if (i != GRIM_HASHTABLE_NONE || !I_hasholdslots(table)->cap)
+        return i;
+    *s = I_hasholdslots(table);
+    return grim_hashslots_find(table, *s, I_hashmigrated(table), key, hash);
+}
+
+// Finds the slot of an entry by its stored hash, if it still has one
+static size_t grim_hashslots_locate(grim_hashslots *s, size_t e) {
+    int8_t h2 = grim_hashtable_h2(s->hashes[e]);
+    if (grim_hashtable_small(s->cap)) {
+        uint32_t bits = grim_group_match(s->ctrl, h2) & grim_hashtable_small_mask(s->cap);
+        for (; bits; bits &= bits - 1)
+            if (s->index[__builtin_ctz(bits)] == e)
+                return __builtin_ctz(bits);
+        return GRIM_HASHTABLE_NONE;
+    }
+
+    size_t pos = grim_hashtable_start(s->hashes[e], s->cap);
+    for (size_t step = GRIM_HASHTABLE_GROUP;; step += GRIM_HASHTABLE_GROUP) {
+        const int8_t *group = s->ctrl + pos;
+        for (uint32_t bits = grim_group_match(group, h2); bits; bits &= bits - 1) {
+            size_t i = (pos + __builtin_ctz(bits)) & (s->cap - 1);
+            if (s->index[i] == e)
+                return i;
+        }
+        if (grim_group_match(group, GRIM_CTRL_EMPTY))
+            return GRIM_HASHTABLE_NONE;
+        pos = (pos + step) & (s->cap - 1);
+    }
 }
 
+// Puts an entry in the given place among the new ones, and gives it a
+// free slot
+static void grim_hashtable_claim(grim_object table, size_t e, grim_object key, grim_object value, uint64_t hash) {
+    grim_hashslots *s = I_hashslots(table);
+    size_t i = grim_hashtable_free_slot(s->ctrl, s->cap, hash);
+    grim_hashtable_set_ctrl(s->ctrl, s->cap, i, grim_hashtable_h2(hash));
+    s->index[i] = e;
+    s->keys[e] = key;
+    s->values[e] = value;
+    s->hashes[e] = hash;
+}
+
+// Moves up to n more old entries over to the new slots, in order, with
+// their weak references.  Entries whose references have been cleared
+// are dropped, and holes are passed over.  The keys are only hashed
+// again if asked to.
+static void grim_hashtable_migrate(grim_object table, size_t n, bool rehash) {
+    grim_hashslots *old = I_hasholdslots(table);
+    size_t end = I_hashmigrated(table) + n < old->used ? I_hashmigrated(table) + n : old->used;
+    for (size_t e = I_hashmigrated(table); e < end; e++) {
+        if (!GRIM_HASHENTRY_LIVE(old, e)) {
+            size_t i;
+            if (I_weakness(table) != GRIM_STRONG && (i = grim_hashslots_locate(old, e)) != GRIM_HASHTABLE_NONE)
+                grim_hashtable_erase(table, old, i);
+            continue;
+        }
+        grim_object key = old->keys[e];
+        uint64_t hash = rehash ? grim_hash(key, 0) : old->hashes[e];
+        size_t f = I_hashplaced(table)++;
+        grim_hashtable_claim(table, f, key, old->values[e], hash);
+        grim_hashslots *s = I_hashslots(table);
+        if (grim_hashtable_weak_keys(table))
+            grim_hashtable_move_ref(&old->keys[e], &s->keys[f]);
+        if (grim_hashtable_weak_values(table))
+            grim_hashtable_move_ref(&old->values[e], &s->values[f]);
+        old->keys[e] = 0;
+        old->values[e] = 0;
+    }
+    I_hashmigrated(table) = end;
+    if (end == old->used) {
+        *old = (grim_hashslots) {0};
+        I_hashmigrated(table) = 0;
+    }
+}
+
+// Moves the current slots aside, to be migrated out of.  The first new
+// entries are kept for the old ones.
+static void grim_hashtable_resize(grim_object table, size_t newcap) {
+    assert(!I_hasholdslots(table)->cap);
+    *I_hasholdslots(table) = *I_hashslots(table);
+    I_hashmigrated(table) = 0;
+    I_hashplaced(table) = 0;
+    grim_hashtable_init(table, newcap);
+    I_hashslots(table)->used = I_hashfill(table);
+}
+
+// Drops all entries with cleared references
+static void grim_hashtable_purge(grim_object table) {
+    grim_hashslots *s = I_hashslots(table);
+    for (size_t i = 0; i < s->cap; i++)
+        if (s->ctrl[i] >= 0 && !GRIM_HASHENTRY_LIVE(s, s->index[i]))
+            grim_hashtable_erase(table, s, i);
+}
+
+// Called when there's no room left for entries.  If many of them are
+// holes, the table is cleaned up at the same size, otherwise it grows.
+// Weak tables are purged first.  Growing should never catch up with
+// itself, but if it does, the old entries are moved on the spot.
 static void grim_hashtable_grow(grim_object table) {
-    size_t oldsize = I_hashcap(table);
-    grim_hashnode **oldnodes = I_hashnodes(table);
-    size_t newsize = (size_t) (oldsize * GRIM_BUFFER_GROWTH_FACTOR);
-    grim_hashnode **newnodes = GC_MALLOC(newsize * sizeof(grim_hashnode *));
-    for (size_t i = 0; i < oldsize; i++) {
-        grim_hashnode *srcnode = oldnodes[i];
-        while (srcnode) {
-            grim_hashnode **tgtnode = grim_hashtable_node(
-                newnodes, srcnode->key, srcnode->hash, newsize, true);
-            (*tgtnode)->value = srcnode->value;
-            srcnode = srcnode->next;
+    if (I_hasholdslots(table)->cap)
+        grim_hashtable_migrate(table, I_hasholdslots(table)->used, false);
+    if (I_weakness(table) != GRIM_STRONG)
+        grim_hashtable_purge(table);
+    size_t cap = I_hashcap(table);
+    if (I_hashfill(table) > GRIM_HASHTABLE_MAX_FILL(cap) / 2)
+        cap *= 2;
+    grim_hashtable_resize(table, cap);
+}
+
+// Rebuilds a table whose keys may hash differently now, all at once
+void grim_hashtable_rehash(grim_object table) {
+    if (I_hasholdslots(table)->cap)
+        grim_hashtable_migrate(table, I_hasholdslots(table)->used, false);
+    grim_hashtable_resize(table, I_hashcap(table));
+    grim_hashtable_migrate(table, I_hasholdslots(table)->used, true);
+}
+
+static inline uint64_t grim_hashtable_hash(grim_object key) {
+    return GRIM_HASHED_BY_IDENTITY(key) ? grim_hash_identity(key, 0) : grim_hash(key, 0);
+}
+
+static inline bool grim_hashtable_lookup(grim_object table, grim_object key, uint64_t hash, grim_object *value) {
+    grim_hashslots *s;
+    size_t i = grim_hashtable_find(table, key, hash, &s);
+    if (i == GRIM_HASHTABLE_NONE)
+        return false;
+    *value = s->values[s->index[i]];
+    return true;
+}
+
+static void grim_hashtable_put(grim_object table, grim_object key, grim_object value, uint64_t hash) {
+    if (I_hasholdslots(table)->cap)
+        grim_hashtable_migrate(table, GRIM_HASHTABLE_MIGRATE, false);
+
+    grim_hashslots *s;
+    size_t i = grim_hashtable_find(table, key, hash, &s);
+    if (i != GRIM_HASHTABLE_NONE) {
+        grim_object *ref = &s->values[s->index[i]];
+        if (grim_hashtable_weak_values(table)) {
+            GC_unregister_disappearing_link((void **) ref);
+            *ref = value;
+            grim_hashtable_weaken(ref);
         }
+        else
+            *ref = value;
+        return;
     }
-    I_hashcap(table) = newsize;
-    I_hashnodes(table) = newnodes;
+
+    s = I_hashslots(table);
+    if (s->used == GRIM_HASHTABLE_MAX_FILL(s->cap))
+        grim_hashtable_grow(table);
+    s = I_hashslots(table);
+    size_t e = s->used++;
+    grim_hashtable_claim(table, e, key, value, hash);
+    if (grim_hashtable_weak_keys(table))
+        grim_hashtable_weaken(&s->keys[e]);
+    if (grim_hashtable_weak_values(table))
+        grim_hashtable_weaken(&s->values[e]);
+    I_hashfill(table)++;
+}
+
+static void grim_hashtable_remove(grim_object table, grim_object key, uint64_t hash) {
+    if (I_hasholdslots(table)->cap)
+        grim_hashtable_migrate(table, GRIM_HASHTABLE_MIGRATE, false);
+
+    grim_hashslots *s;
+    size_t i = grim_hashtable_find(table, key, hash, &s);
+    if (i != GRIM_HASHTABLE_NONE)
+        grim_hashtable_erase(table, s, i);
+}
+
+
+// Concurrent tables
+// -----------------------------------------------------------------------------
+
+// A concurrent table keeps its entries in GRIM_HASHTABLE_SHARDS
+// ordinary tables, picked by the top bits of the hash.  Writers take
+// the lock of a shard, and keep its sequence number odd while they
+// change it.  Readers take no lock: they copy the slots of the shard,
+// pick out the keys in them that could be the one they're after, and
+// then check that the sequence number is even and hasn't changed, or
+// try again.  Only then are the keys compared with grim_equal, which
+// may look at anything.  A reader that keeps running into writers
+// waits for the lock instead.
+//
+// Shards grow incrementally, like any other table, and readers look at
+// their old slots as well.  Arrays that a shard is done with aren't
+// collected while a reader is looking at them, as it has them on its
+// stack.  Whatever a reader reads is loaded once, so that what it
+// checked is what it uses.
+
+#define GRIM_HASHSHARD_ATTEMPTS (16)
+#define GRIM_HASHSHARD_CANDIDATES (4)
+#define GRIM_HASHSHARD_POS_BITS (56)
+
+static_assert(GRIM_HASHTABLE_SHARDS <= 16, "");
+
+#define GRIM_LOAD(x) __atomic_load_n(&(x), __ATOMIC_RELAXED)
+
+grim_object grim_hashtable_create_concurrent(size_t sizehint) {
+    grim_object obj = grim_hashtable_create(0);
+    grim_hashshard *shards = grim_alloc(GRIM_HASHTABLE_SHARDS * sizeof(grim_hashshard), GRIM_LAYOUT_CONSERVATIVE);
+    for (size_t k = 0; k < GRIM_HASHTABLE_SHARDS; k++) {
+        pthread_mutex_init(&shards[k].lock, NULL);
+        atomic_init(&shards[k].seq, 0);
+        shards[k].table = grim_hashtable_create((sizehint + GRIM_HASHTABLE_SHARDS - 1) / GRIM_HASHTABLE_SHARDS);
+    }
+    I_hashshards(obj) = shards;
+    return obj;
+}
+
+static inline grim_hashshard *grim_hashtable_shard(grim_object table, uint64_t hash) {
+    return &I_hashshards(table)[(hash >> 60) & (GRIM_HASHTABLE_SHARDS - 1)];
+}
+
+static void grim_hashshard_lock(grim_hashshard *shard) {
+    pthread_mutex_lock(&shard->lock);
+    size_t seq = atomic_load_explicit(&shard->seq, memory_order_relaxed);
+    atomic_store_explicit(&shard->seq, seq + 1, memory_order_relaxed);
+    atomic_thread_fence(memory_order_release);
+}
+
+static void grim_hashshard_unlock(grim_hashshard *shard) {
+    size_t seq = atomic_load_explicit(&shard->seq, memory_order_relaxed);
+    atomic_store_explicit(&shard->seq, seq + 1, memory_order_release);
+    pthread_mutex_unlock(&shard->lock);
+}
+
+// Adds the entry in a slot to the candidates, if its key could be the
+// one.  Returns false if there are too many.  A slot that's changing
+// may have any index, and one that has been moved has no key.
+static inline bool grim_hashslots_pick(const grim_hashslots *s, size_t i, grim_object key, uint64_t hash,
+                                       grim_object *cands, size_t *ncands) {
+    size_t e = GRIM_LOAD(s->index[i]);
+    if (e >= GRIM_HASHTABLE_MAX_FILL(s->cap))
+        return true;
+    grim_object other = GRIM_LOAD(s->keys[e]);
+    if (!other || (other != key && (GRIM_HASHED_BY_IDENTITY(key) || GRIM_LOAD(s->hashes[e]) != hash)))
+        return true;
+    if (*ncands == GRIM_HASHSHARD_CANDIDATES)
+        return false;
+    cands[2 * *ncands] = other;
+    cands[2 * *ncands + 1] = GRIM_LOAD(s->values[e]);
+    (*ncands)++;
+    return true;
+}
+
+// Like grim_hashslots_find, but for slots that may be changing.  The
+// probe is bounded, since it may never come across an empty slot.
+static bool grim_hashslots_peek(const grim_hashslots *s, grim_object key, uint64_t hash,
+                                grim_object *cands, size_t *ncands) {
+    int8_t h2 = grim_hashtable_h2(hash);
+    if (!s->cap)
+        return true;
+    if (grim_hashtable_small(s->cap)) {
+        uint32_t bits = grim_group_match(s->ctrl, h2) & grim_hashtable_small_mask(s->cap);
+        for (; bits; bits &= bits - 1)
+            if (!grim_hashslots_pick(s, __builtin_ctz(bits), key, hash, cands, ncands))
+                return false;
+        return true;
+    }
+
+    size_t pos = grim_hashtable_start(hash, s->cap);
+    for (size_t step = GRIM_HASHTABLE_GROUP; step <= s->cap; step += GRIM_HASHTABLE_GROUP) {
+        const int8_t *group = s->ctrl + pos;
+        for (uint32_t bits = grim_group_match(group, h2); bits; bits &= bits - 1)
+            if (!grim_hashslots_pick(s, (pos + __builtin_ctz(bits)) & (s->cap - 1), key, hash, cands, ncands))
+                return false;
+        if (grim_group_match(group, GRIM_CTRL_EMPTY))
+            return true;
+        pos = (pos + step) & (s->cap - 1);
+    }
+    return true;
+}
+
+static inline bool grim_hashshard_unchanged(grim_hashshard *shard, size_t seq) {
+    atomic_thread_fence(memory_order_acquire);
+    return atomic_load_explicit(&shard->seq, memory_order_relaxed) == seq;
+}
+
+static inline void grim_hashslots_load(grim_hashslots *dst, const grim_hashslots *src) {
+    dst->ctrl = GRIM_LOAD(src->ctrl);
+    dst->index = GRIM_LOAD(src->index);
+    dst->keys = GRIM_LOAD(src->keys);
+    dst->values = GRIM_LOAD(src->values);
+    dst->hashes = GRIM_LOAD(src->hashes);
+    dst->cap = GRIM_LOAD(src->cap);
+}
+
+static bool grim_hashshard_lookup(grim_hashshard *shard, grim_object key, uint64_t hash, grim_object *value) {
+    grim_object table = shard->table;
+    for (int attempt = 0; attempt < GRIM_HASHSHARD_ATTEMPTS; attempt++) {
+        size_t seq = atomic_load_explicit(&shard->seq, memory_order_acquire);
+        if (seq & 1)
+            continue;
+
+        // The slots must be whole before they're looked in
+        grim_hashslots slots[2];
+        grim_hashslots_load(&slots[0], I_hashslots(table));
+        grim_hashslots_load(&slots[1], I_hasholdslots(table));
+        if (!grim_hashshard_unchanged(shard, seq))
+            continue;
+
+        grim_object cands[2 * GRIM_HASHSHARD_CANDIDATES];
+        size_t ncands = 0;
+        bool complete = grim_hashslots_peek(&slots[0], key, hash, cands, &ncands) &&
+            grim_hashslots_peek(&slots[1], key, hash, cands, &ncands);
+        if (!grim_hashshard_unchanged(shard, seq))
+            continue;
+        if (!complete)
+            break;
+
+        for (size_t c = 0; c < ncands; c++)
+            if (cands[2 * c] == key || grim_equal(key, cands[2 * c])) {
+                *value = cands[2 * c + 1];
+                return true;
+            }
+        return false;
+    }
+
+    pthread_mutex_lock(&shard->lock);
+    bool found = grim_hashtable_lookup(table, key, hash, value);
+    pthread_mutex_unlock(&shard->lock);
+    return found;
+}
+
+static void grim_hashshard_put(grim_hashshard *shard, grim_object key, grim_object value, uint64_t hash) {
+    grim_hashshard_lock(shard);
+    grim_hashtable_put(shard->table, key, value, hash);
+    grim_hashshard_unlock(shard);
+}
+
+static void grim_hashshard_remove(grim_hashshard *shard, grim_object key, uint64_t hash) {
+    grim_hashshard_lock(shard);
+    grim_hashtable_remove(shard->table, key, hash);
+    grim_hashshard_unlock(shard);
+}
+
+// Steps through the entries of a concurrent table shard by shard, with
+// the shard in the top bits of the position
+static bool grim_hashshard_next(grim_object table, size_t *pos, grim_object *key, grim_object *value) {
+    size_t mask = ((size_t) 1 << GRIM_HASHSHARD_POS_BITS) - 1;
+    for (size_t k; (k = *pos >> GRIM_HASHSHARD_POS_BITS) < GRIM_HASHTABLE_SHARDS;
+         *pos = (k + 1) << GRIM_HASHSHARD_POS_BITS) {
+        size_t inner = *pos & mask;
+        if (grim_hashtable_next(I_hashshards(table)[k].table, &inner, key, value)) {
+            *pos = (k << GRIM_HASHSHARD_POS_BITS) | inner;
+            return true;
+        }
+    }
+    return false;
+}
+
+// Everything below works on both kinds of table
+
+// While a table grows, the entries that have been moved come first,
+// then those still in the old slots, and then the rest of the new ones.
+// Cleared entries are skipped.
+bool grim_hashtable_next(grim_object table, size_t *pos, grim_object *key, grim_object *value) {
+    if (I_hashshards(table))
+        return grim_hashshard_next(table, pos, key, value);
+
+    grim_hashslots *new = I_hashslots(table), *old = I_hasholdslots(table);
+    size_t placed = old->cap ? I_hashplaced(table) : 0;
+    for (; *pos < new->used + old->used; (*pos)++) {
+        grim_hashslots *s = new;
+        size_t e = *pos;
+        if (e >= placed + old->used)
+            e -= old->used;
+        else if (e >= placed) {
+            s = old;
+            e -= placed;
+        }
+        if (GRIM_HASHENTRY_LIVE(s, e)) {
+            *key = s->keys[e];
+            *value = s->values[e];
+            (*pos)++;
+            return true;
+        }
+    }
+    return false;
 }
 
 bool grim_hashtable_has(grim_object table, grim_object key) {
-    grim_hashnode **node = grim_hashtable_node(
-        I_hashnodes(table), key, grim_hash(key, 0), I_hashcap(table), false);
-    return (*node) ? true : false;
+    uint64_t hash = grim_hashtable_hash(key);
+    grim_object value;
+    if (I_hashshards(table))
+        return grim_hashshard_lookup(grim_hashtable_shard(table, hash), key, hash, &value);
+    return grim_hashtable_lookup(table, key, hash, &value);
 }
 
 grim_object grim_hashtable_get(grim_object table, grim_object key) {
-    grim_hashnode **node = grim_hashtable_node(
-        I_hashnodes(table), key, grim_hash(key, 0), I_hashcap(table), false);
-    return (*node) ? (*node)->value : grim_undefined;
+    uint64_t hash = grim_hashtable_hash(key);
+    grim_object value;
+    bool found = I_hashshards(table) ?
+        grim_hashshard_lookup(grim_hashtable_shard(table, hash), key, hash, &value) :
+        grim_hashtable_lookup(table, key, hash, &value);
+    return found ? value : grim_undefined;
 }
 
 void grim_hashtable_set(grim_object table, grim_object key, grim_object value) {
-    size_t hash = grim_hash(key, 0);
-    grim_hashnode **node = grim_hashtable_node(I_hashnodes(table), key, hash, I_hashcap(table), true);
-    if ((*node)->value == grim_undefined && I_hashfill(table) > I_hashcap(table) * GRIM_HASHTABLE_MAX_FILL) {
-        grim_hashtable_grow(table);
-        node = grim_hashtable_node(I_hashnodes(table), key, hash, I_hashcap(table), true);
-    }
-    if ((*node)->value == grim_undefined)
-        I_hashfill(table)++;
-    (*node)->value = value;
+    uint64_t hash = grim_hashtable_hash(key);
+    if (I_hashshards(table))
+        grim_hashshard_put(grim_hashtable_shard(table, hash), key, value, hash);
+    else
+        grim_hashtable_put(table, key, value, hash);
 }
 
 void grim_hashtable_unset(grim_object table, grim_object key) {
-    size_t hash = grim_hash(key, 0);
-    grim_hashnode **node = grim_hashtable_node(I_hashnodes(table), key, hash, I_hashcap(table), false);
-    if (*node) {
-        *node = (*node)->next;
-        I_hashfill(table)--;
-    }
+    uint64_t hash = grim_hashtable_hash(key);
+    if (I_hashshards(table))
+        grim_hashshard_remove(grim_hashtable_shard(table, hash), key, hash);
+    else
+        grim_hashtable_remove(table, key, hash);
 }
 
-
 // Cells
 // -----------------------------------------------------------------------------
 
 grim_object grim_cell_pack(grim_object value) {
-    grim_object obj = grim_indirect_create(false);
+    grim_object obj = grim_indirect_create(sizeof(grim_icell), GRIM_LAYOUT_CONSERVATIVE);
     I_tag(obj) = GRIM_CELL_TAG;
     I_cellvalue(obj) = value;
     return obj;
@@ -326,7 +951,7 @@ grim_object grim_cell_pack(grim_object value) {
 // -----------------------------------------------------------------------------
 
 grim_object grim_module_create(grim_object name) {
-    grim_object ind = grim_indirect_create(false);
+    grim_object ind = grim_indirect_create(sizeof(grim_imodule), GRIM_LAYOUT_CONSERVATIVE);
     I_tag(ind) = GRIM_MODULE_TAG;
     I_modulename(ind) = name;
     I_modulemembers(ind) = grim_hashtable_create(0);
@@ -356,7 +981,10 @@ void grim_module_set(grim_object module, grim_object name, grim_object value) {
 // -----------------------------------------------------------------------------
 
 grim_object grim_cfunc_create(grim_cfunc *cfunc, uint8_t nargs, bool variadic) {
-    grim_object obj = grim_indirect_create(false);
+    // C functions refer to nothing in the heap, and are only made for
+    // builtins, which live forever anyway
+    grim_object obj = grim_indirect_create(sizeof(grim_ifunc), GRIM_LAYOUT_IMMORTAL);
+    grim_census_immortal(GRIM_FUNCTION, sizeof(grim_ifunc));
     I_tag(obj) = GRIM_CFUNC_TAG;
     I_cfunc(obj) = cfunc;
     I_nargs(obj) = nargs;
@@ -365,7 +993,7 @@ grim_object grim_cfunc_create(grim_cfunc *cfunc, uint8_t nargs, bool variadic) {
 }
 
 grim_object grim_lfunc_create(grim_object bytecode, grim_object refs, uint8_t nlocals, uint8_t nargs, bool variadic) {
-    grim_object obj = grim_indirect_create(false);
+    grim_object obj = grim_indirect_create(sizeof(grim_ifunc), GRIM_LAYOUT_CONSERVATIVE);
     I_tag(obj) = GRIM_LFUNC_TAG;
     I_bytecode(obj) = bytecode;
     I_funcrefs(obj) = refs;
@@ -380,7 +1008,7 @@ grim_object grim_lfunc_create(grim_object bytecode, grim_object refs, uint8_t nl
 // -----------------------------------------------------------------------------
 
 grim_object grim_frame_create(grim_object func, grim_object parent) {
-    grim_object frame = grim_indirect_create(false);
+    grim_object frame = grim_indirect_create(sizeof(grim_iframe), GRIM_LAYOUT_CONSERVATIVE);
     I_tag(frame) = GRIM_FRAME_TAG;
     I_framefunc(frame) = func;
 
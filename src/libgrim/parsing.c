@@ -14,6 +14,9 @@ typedef struct {
     grim_object str;
     size_t offset;
     int next_size;
+
+    // Temporary storage for the form being read
+    grim_arena scratch;
 } str_iter;
 
 typedef struct {
@@ -44,12 +47,15 @@ static bool parse_object(void *out, str_iter *iter, parse_params *params);
 // Source code inspection
 // -----------------------------------------------------------------------------
 
-static char *substring(str_iter *iter, size_t start) {
-    size_t len = iter->offset - start;
-    char *code = malloc((len + 1) * sizeof(char));
-    memcpy(code, I_str(iter->str) + start, len);
-    code[len] = 0;
-    return code;
+static void iter_init(str_iter *iter, grim_object str) {
+    iter->str = str;
+    iter->offset = 0;
+    iter->next_size = 0;
+    grim_arena_init(&iter->scratch);
+}
+
+static inline const char *substring(str_iter *iter, size_t start) {
+    return (const char *) &I_str(iter->str)[start];
 }
 
 static inline bool done(str_iter *iter) {
@@ -138,15 +144,11 @@ static size_t consume_while(str_iter *iter, charpred pred, int param) {
 }
 
 static void read_uint(grim_object *out, str_iter *iter, size_t start, int base) {
-    char *code = substring(iter, start);
-    *out = grim_integer_read(code, base);
-    free(code);
+    *out = grim_integer_parse(&iter->scratch, substring(iter, start), iter->offset - start, base);
 }
 
 static void read_float(grim_object *out, str_iter *iter, size_t start) {
-    char *code = substring(iter, start);
-    *out = grim_float_read(code);
-    free(code);
+    *out = grim_float_parse(&iter->scratch, substring(iter, start), iter->offset - start);
 }
 
 
@@ -227,9 +229,8 @@ static bool parse_decimal_2(void *out, str_iter *iter, parse_params *params) {
     if (pounds_before && ndigits_after > 0)
         return false;
 
-    char *code = substring(iter, start);
-    grim_object scale = grim_integer_read(code, 10);
-    free(code);
+    grim_object scale;
+    read_uint(&scale, iter, start, 10);
 
     intmax_t exp = 0;
     try(&exp, iter, parse_exponent, 0);
@@ -514,29 +515,85 @@ static bool parse_list(void *out, str_iter *iter, parse_params *params) {
 static bool parse_vector(void *out, str_iter *iter, parse_params *params) {
     if (safe_next(iter) != '#')
         return false;
-
-    // Parse the vector as a non-dotted list
-    parse_params subparams = *params;
-    subparams.allow_dotted = false;
-    grim_object list;
-    if (!try(&list, iter, parse_list, &subparams))
+    if (safe_next(iter) != '(')
         return false;
 
-    // Count number of elements
-    size_t nelems = 0;
-    grim_object cons = list;
-    while (cons != grim_nil) {
-        nelems++;
-        cons = I_cdr(cons);
+    grim_object vec = grim_vector_create(0);
+    while (true) {
+        consume_while(iter, is_whitespace, 0);
+        if (safe_peek(iter) == ')') {
+            unsafe_advance(iter);
+            break;
+        }
+
+        grim_object element;
+        if (!try(&element, iter, parse_object, params))
+            return false;
+        grim_vector_push(vec, element);
+    }
+
+    *((grim_object *) out) = vec;
+    return true;
+}
+
+// Elements are collected in the scratch arena, doubling as needed, and
+// copied into a vector of the right size at the end
+static bool parse_numvector(void *out, str_iter *iter, parse_params *params) {
+    if (safe_next(iter) != '#')
+        return false;
+    grim_tag_t tag;
+    switch (safe_next(iter)) {
+    case 'f': tag = GRIM_F64VECTOR_TAG; break;
+    case 's': tag = GRIM_S64VECTOR_TAG; break;
+    case 'u': tag = GRIM_BYTEVECTOR_TAG; break;
+    default: return false;
     }
+    const char *suffix = tag == GRIM_BYTEVECTOR_TAG ? "8(" : "64(";
+    for (const char *ch = suffix; *ch; ch++)
+        if (safe_next(iter) != (ucs4_t) *ch)
+            return false;
+
+    size_t eltsize = grim_numvector_eltsize(tag);
+    size_t nelems = 0, cap = 16;
+    char *elts = grim_arena_alloc(&iter->scratch, cap * eltsize);
+    while (true) {
+        consume_while(iter, is_whitespace, 0);
+        if (safe_peek(iter) == ')') {
+            unsafe_advance(iter);
+            break;
+        }
 
-    // Build vector
-    grim_object vec = grim_vector_create(nelems);
-    for (size_t i = 0; i < nelems; i++) {
-        I_vectorelt(vec, i) = I_car(list);
-        list = I_cdr(list);
+        grim_object num;
+        if (!try(&num, iter, parse_number, params))
+            return false;
+        if (nelems == cap) {
+            char *newelts = grim_arena_alloc(&iter->scratch, 2 * cap * eltsize);
+            memcpy(newelts, elts, cap * eltsize);
+            elts = newelts;
+            cap *= 2;
+        }
+
+        grim_type_t type = grim_type(num);
+        if (tag == GRIM_F64VECTOR_TAG) {
+            if (type != GRIM_INTEGER && type != GRIM_FLOAT && type != GRIM_RATIONAL)
+                return false;
+            ((double *) elts)[nelems++] = grim_to_double(num);
+            continue;
+        }
+        if (type != GRIM_INTEGER || !grim_integer_extractable(num))
+            return false;
+        intmax_t value = grim_integer_extract(num);
+        if (tag == GRIM_S64VECTOR_TAG)
+            ((int64_t *) elts)[nelems++] = value;
+        else if (value >= 0 && value <= UINT8_MAX)
+            ((uint8_t *) elts)[nelems++] = value;
+        else
+            return false;
     }
 
+    grim_object vec = grim_numvector_create(tag, nelems);
+    if (nelems)
+        memcpy(I_numdata(vec), elts, nelems * eltsize);
     *((grim_object *) out) = vec;
     return true;
 }
@@ -545,6 +602,7 @@ static bool parse_object(void *out, str_iter *iter, parse_params *params) {
     consume_while(iter, is_whitespace, 0);
     if (try(out, iter, parse_string, params) ||
         try(out, iter, parse_character, params) ||
+        try(out, iter, parse_numvector, params) ||
         try(out, iter, parse_boolean, params) ||
         try(out, iter, parse_number, params) ||
         try(out, iter, parse_list, params) ||
@@ -575,14 +633,17 @@ static grim_object read_exp(str_iter *iter) {
 
 grim_object grim_read_all(grim_object str) {
     grim_object head = grim_nil, tail;
-    str_iter iter = {str, 0, 0};
+    str_iter iter;
+    iter_init(&iter, str);
     parse_params params = {
         .encoding = NULL,
         .allow_dotted = true,
     };
     while (true) {
         grim_object obj;
-        if (!try(&obj, &iter, parse_object, &params))
+        bool success = try(&obj, &iter, parse_object, &params);
+        grim_arena_reset(&iter.scratch);
+        if (!success)
             break;
         if (head == grim_nil)
             head = tail = grim_cons_pack(obj, grim_nil);
@@ -592,6 +653,7 @@ grim_object grim_read_all(grim_object str) {
             tail = newtail;
         }
     }
+    grim_arena_free(&iter.scratch);
     consume_while(&iter, is_whitespace, 0);
     if (!done(&iter))
         return grim_undefined;
@@ -600,6 +662,9 @@ grim_object grim_read_all(grim_object str) {
 
 
 grim_object grim_read(grim_object str) {
-    str_iter iter = {str, 0, 0};
-    return read_exp(&iter);
+    str_iter iter;
+    iter_init(&iter, str);
+    grim_object retval = read_exp(&iter);
+    grim_arena_free(&iter.scratch);
+    return retval;
 }
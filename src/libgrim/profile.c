@@ -0,0 +1,298 @@
+#define _GNU_SOURCE
+#include <assert.h>
+#include <dlfcn.h>
+#include <execinfo.h>
+#include <inttypes.h>
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "gc.h"
+
+#include "grim.h"
+#include "internal.h"
+
+
+// Allocation profiler
+// -----------------------------------------------------------------------------
+
+// While profiling, every allocation made through grim_alloc,
+// grim_indirect_create and grim_realloc, and every allocation of GMP
+// limbs, is recorded twice: once under the C call stack that made it,
+// and once under the Grim function that was running at the time, if
+// any.  Stacks are captured with backtrace(), which is slow, but this
+// is only done on request.
+//
+// Call stacks are kept in a malloc'd table, as they only hold code
+// addresses.  The function table is uncollectable, so that functions
+// stay alive, and their addresses aren't reused, while they are in it.
+
+#define GRIM_PROFILE_DEPTH (16)
+#define GRIM_PROFILE_MIN_SIZE (1024)
+
+typedef struct {
+    uint64_t hash;
+    size_t depth;
+    void *pcs[GRIM_PROFILE_DEPTH];
+    size_t count;
+    size_t bytes;
+} grim_profile_site;
+
+typedef struct {
+    grim_object func;
+    size_t count;
+    size_t bytes;
+} grim_profile_func;
+
+bool grim_profiling;
+
+static pthread_mutex_t grim_profile_lock = PTHREAD_MUTEX_INITIALIZER;
+static grim_profile_site *grim_profile_sites;
+static size_t grim_profile_sites_cap;
+static size_t grim_profile_sites_fill;
+static grim_profile_func *grim_profile_funcs;
+static size_t grim_profile_funcs_cap;
+static size_t grim_profile_funcs_fill;
+static size_t grim_profile_count;
+static size_t grim_profile_bytes;
+
+static uint64_t grim_profile_hash(void *const *pcs, size_t depth) {
+    uint64_t h = depth;
+    for (size_t i = 0; i < depth; i++)
+        h = (h ^ (uintptr_t) pcs[i]) * 0x100000001b3;
+    return h ^ (h >> 29);
+}
+
+static grim_profile_site *grim_profile_site_slot(grim_profile_site *sites, size_t cap, uint64_t hash,
+                                                 void *const *pcs, size_t depth) {
+    size_t i = hash & (cap - 1);
+    while (sites[i].depth && (sites[i].hash != hash || sites[i].depth != depth ||
+                              memcmp(sites[i].pcs, pcs, depth * sizeof(void *))))
+        i = (i + 1) & (cap - 1);
+    return &sites[i];
+}
+
+static grim_profile_func *grim_profile_func_slot(grim_profile_func *funcs, size_t cap, grim_object func) {
+    size_t i = (func >> 4) * 0x9e3779b97f4a7c15 >> 32;
+    for (i &= cap - 1; funcs[i].func && funcs[i].func != func; i = (i + 1) & (cap - 1));
+    return &funcs[i];
+}
+
+static void grim_profile_grow_sites() {
+    size_t newcap = grim_profile_sites_cap ? 2 * grim_profile_sites_cap : GRIM_PROFILE_MIN_SIZE;
+    grim_profile_site *newsites = calloc(newcap, sizeof(grim_profile_site));
+    assert(newsites);
+    for (size_t i = 0; i < grim_profile_sites_cap; i++) {
+        grim_profile_site *site = &grim_profile_sites[i];
+        if (site->depth)
+            *grim_profile_site_slot(newsites, newcap, site->hash, site->pcs, site->depth) = *site;
+    }
+    free(grim_profile_sites);
+    grim_profile_sites = newsites;
+    grim_profile_sites_cap = newcap;
+}
+
+static void grim_profile_grow_funcs() {
+    size_t newcap = grim_profile_funcs_cap ? 2 * grim_profile_funcs_cap : GRIM_PROFILE_MIN_SIZE;
+    grim_profile_func *newfuncs = GC_MALLOC_UNCOLLECTABLE(newcap * sizeof(grim_profile_func));
+    assert(newfuncs);
+    for (size_t i = 0; i < grim_profile_funcs_cap; i++) {
+        grim_profile_func *entry = &grim_profile_funcs[i];
+        if (entry->func)
+            *grim_profile_func_slot(newfuncs, newcap, entry->func) = *entry;
+    }
+    GC_FREE(grim_profile_funcs);
+    grim_profile_funcs = newfuncs;
+    grim_profile_funcs_cap = newcap;
+}
+
+// Called by the allocator, which is skip frames up from here.
+// Allocations made outside any Grim function are filed under
+// undefined.
+void grim_profile_record(size_t size, int skip) {
+    void *pcs[GRIM_PROFILE_DEPTH + 4];
+    int depth = backtrace(pcs, GRIM_PROFILE_DEPTH + skip);
+    depth = depth > skip ? depth - skip : 0;
+    grim_object func = grim_top_frame == grim_undefined ? grim_undefined : I_framefunc(grim_top_frame);
+
+    pthread_mutex_lock(&grim_profile_lock);
+    grim_profile_count++;
+    grim_profile_bytes += size;
+
+    if (2 * (grim_profile_sites_fill + 1) > grim_profile_sites_cap)
+        grim_profile_grow_sites();
+    uint64_t hash = grim_profile_hash(pcs + skip, depth);
+    grim_profile_site *site = grim_profile_site_slot(
+        grim_profile_sites, grim_profile_sites_cap, hash, pcs + skip, depth);
+    if (!site->depth) {
+        site->hash = hash;
+        site->depth = depth;
+        memcpy(site->pcs, pcs + skip, depth * sizeof(void *));
+        grim_profile_sites_fill++;
+    }
+    site->count++;
+    site->bytes += size;
+
+    if (2 * (grim_profile_funcs_fill + 1) > grim_profile_funcs_cap)
+        grim_profile_grow_funcs();
+    grim_profile_func *entry = grim_profile_func_slot(grim_profile_funcs, grim_profile_funcs_cap, func);
+    if (!entry->func) {
+        entry->func = func;
+        grim_profile_funcs_fill++;
+    }
+    entry->count++;
+    entry->bytes += size;
+    pthread_mutex_unlock(&grim_profile_lock);
+}
+
+// Starts profiling afresh, dropping anything recorded before
+void grim_profile_start() {
+    // The first backtrace may load the unwinder, which allocates
+    void *pcs[1];
+    backtrace(pcs, 1);
+
+    pthread_mutex_lock(&grim_profile_lock);
+    free(grim_profile_sites);
+    GC_FREE(grim_profile_funcs);
+    grim_profile_sites = NULL;
+    grim_profile_funcs = NULL;
+    grim_profile_sites_cap = grim_profile_sites_fill = 0;
+    grim_profile_funcs_cap = grim_profile_funcs_fill = 0;
+    grim_profile_count = grim_profile_bytes = 0;
+    grim_profiling = true;
+    pthread_mutex_unlock(&grim_profile_lock);
+    grim_gmp_profile(true);
+}
+
+void grim_profile_stop() {
+    grim_gmp_profile(false);
+    grim_profiling = false;
+}
+
+
+// Reports
+// -----------------------------------------------------------------------------
+
+static int grim_profile_site_cmp(const void *a, const void *b) {
+    const grim_profile_site *x = *(grim_profile_site *const *) a, *y = *(grim_profile_site *const *) b;
+    return x->bytes < y->bytes ? 1 : x->bytes > y->bytes ? -1 : 0;
+}
+
+static int grim_profile_func_cmp(const void *a, const void *b) {
+    const grim_profile_func *x = a, *y = b;
+    return x->bytes < y->bytes ? 1 : x->bytes > y->bytes ? -1 : 0;
+}
+
+static void grim_profile_print_pc(FILE *stream, void *pc) {
+    Dl_info info;
+    if (dladdr(pc, &info) && info.dli_sname)
+        fprintf(stream, "%s+0x%tx", info.dli_sname, (char *) pc - (char *) info.dli_saddr);
+    else
+        fprintf(stream, "%p", pc);
+}
+
+// Looks for a function among the bindings of a module
+static grim_object grim_profile_func_name(grim_object module, grim_object func) {
+    if (module == grim_undefined)
+        return grim_undefined;
+    grim_object name, cell;
+    for (size_t pos = 0; grim_hashtable_next(I_modulemembers(module), &pos, &name, &cell);)
+        if (I_cellvalue(cell) == func)
+            return name;
+    return grim_undefined;
+}
+
+// Prints the nsites call stacks that allocated the most, heaviest
+// first, each with its top frames, and then all the Grim functions.
+// Functions are named after their bindings in the given module, or in
+// the builtin module, if they are found there.
+void grim_profile_report(FILE *stream, grim_object module, size_t nsites) {
+    pthread_mutex_lock(&grim_profile_lock);
+    fprintf(stream, "Allocation profile: %zu allocations, %zu bytes\n\n", grim_profile_count, grim_profile_bytes);
+
+    grim_profile_site **sites = malloc((grim_profile_sites_fill + 1) * sizeof(grim_profile_site *));
+    assert(sites);
+    size_t n = 0;
+    for (size_t i = 0; i < grim_profile_sites_cap; i++)
+        if (grim_profile_sites[i].depth)
+            sites[n++] = &grim_profile_sites[i];
+    qsort(sites, n, sizeof(grim_profile_site *), grim_profile_site_cmp);
+
+    fprintf(stream, "%12s %10s  %s\n", "bytes", "count", "call site");
+    for (size_t i = 0; i < n && i < nsites; i++) {
+        fprintf(stream, "%12zu %10zu  ", sites[i]->bytes, sites[i]->count);
+        for (size_t j = 0; j < sites[i]->depth && j < 4; j++) {
+            if (j > 0)
+                fprintf(stream, " < ");
+            grim_profile_print_pc(stream, sites[i]->pcs[j]);
+        }
+        fprintf(stream, "\n");
+    }
+    free(sites);
+
+    grim_profile_func *funcs = malloc((grim_profile_funcs_fill + 1) * sizeof(grim_profile_func));
+    assert(funcs);
+    n = 0;
+    for (size_t i = 0; i < grim_profile_funcs_cap; i++)
+        if (grim_profile_funcs[i].func)
+            funcs[n++] = grim_profile_funcs[i];
+    qsort(funcs, n, sizeof(grim_profile_func), grim_profile_func_cmp);
+    pthread_mutex_unlock(&grim_profile_lock);
+
+    fprintf(stream, "\n%12s %10s  %s\n", "bytes", "count", "function");
+    for (size_t i = 0; i < n; i++) {
+        fprintf(stream, "%12zu %10zu  ", funcs[i].bytes, funcs[i].count);
+        if (funcs[i].func == grim_undefined) {
+            fprintf(stream, "(none)\n");
+            continue;
+        }
+        grim_object name = grim_profile_func_name(module, funcs[i].func);
+        if (name == grim_undefined)
+            name = grim_profile_func_name(grim_builtin_module, funcs[i].func);
+        if (name != grim_undefined)
+            fprintf(stream, "%s ", (const char *) I_str(I_symbolname(name)));
+        fprintf(stream, "#<function %p>\n", (void *) funcs[i].func);
+    }
+    free(funcs);
+}
+
+// Writes the call stacks in the legacy text format of gperftools' heap
+// profiler, which pprof reads.  Both the in-use and the allocated
+// columns count everything allocated while profiling, whether it's
+// still alive or not.
+bool grim_profile_write_pprof(const char *path) {
+    FILE *file = fopen(path, "w");
+    if (!file)
+        return false;
+
+    pthread_mutex_lock(&grim_profile_lock);
+    fprintf(file, "heap profile: %6zu: %8zu [%6zu: %8zu] @ heapprofile\n",
+            grim_profile_count, grim_profile_bytes, grim_profile_count, grim_profile_bytes);
+    for (size_t i = 0; i < grim_profile_sites_cap; i++) {
+        grim_profile_site *site = &grim_profile_sites[i];
+        if (!site->depth)
+            continue;
+        fprintf(file, "%6zu: %8zu [%6zu: %8zu] @", site->count, site->bytes, site->count, site->bytes);
+        for (size_t j = 0; j < site->depth; j++)
+            fprintf(file, " 0x%016" PRIxPTR, (uintptr_t) site->pcs[j]);
+        fprintf(file, "\n");
+    }
+    pthread_mutex_unlock(&grim_profile_lock);
+
+    // pprof needs the memory map to find the binaries
+    fprintf(file, "\nMAPPED_LIBRARIES:\n");
+    FILE *maps = fopen("/proc/self/maps", "r");
+    if (maps) {
+        char buf[4096];
+        size_t len;
+        while ((len = fread(buf, 1, sizeof(buf), maps)) > 0)
+            fwrite(buf, 1, len, file);
+        fclose(maps);
+    }
+
+    bool ok = !ferror(file);
+    return fclose(file) == 0 && ok;
+}
@@ -229,6 +229,8 @@ void grim_unescape_string(grim_object str) {
     }
 
     I_strlen(str) = tgtptr - I_str(str);
+    I_strhash(str) = 0;
+    *tgtptr = 0;
 }
 
 
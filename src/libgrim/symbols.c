@@ -0,0 +1,147 @@
+#include <assert.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "uniconv.h"
+
+#include "grim.h"
+#include "internal.h"
+
+
+// Symbol table
+// -----------------------------------------------------------------------------
+
+// Symbols are interned in a chained hash table of their own.  The
+// chains run through the symbols themselves, and the bucket array is
+// malloc'd: since symbols are never collected, and don't point into the
+// collected heap, none of this needs to be visible to the collector.
+
+#define GRIM_SYMBOLS_MIN_SIZE (1024)
+
+static grim_isymbol **grim_symbols;
+static size_t grim_symbols_cap;
+static size_t grim_symbols_fill;
+
+void grim_symbols_init() {
+    grim_symbols_cap = GRIM_SYMBOLS_MIN_SIZE;
+    grim_symbols_fill = 0;
+    grim_symbols = calloc(grim_symbols_cap, sizeof(grim_isymbol *));
+    assert(grim_symbols);
+}
+
+static void grim_symbols_grow() {
+    size_t newcap = 2 * grim_symbols_cap;
+    grim_isymbol **newsymbols = calloc(newcap, sizeof(grim_isymbol *));
+    assert(newsymbols);
+    for (size_t i = 0; i < grim_symbols_cap; i++) {
+        grim_isymbol *sym = grim_symbols[i];
+        while (sym) {
+            grim_isymbol *next = sym->symbolnext;
+            grim_isymbol **bucket = &newsymbols[sym->symbolhash & (newcap - 1)];
+            sym->symbolnext = *bucket;
+            *bucket = sym;
+            sym = next;
+        }
+    }
+    free(grim_symbols);
+    grim_symbols = newsymbols;
+    grim_symbols_cap = newcap;
+}
+
+// The name must be aligned like any other indirect object
+static_assert(offsetof(grim_isymbol, symbolname) % GRIM_GRANULE_BYTES == 0, "");
+
+static grim_isymbol *grim_symbol_create(const uint8_t *name, size_t length, uint64_t hash) {
+    grim_isymbol *sym = grim_alloc(sizeof(grim_isymbol) + length + 1, GRIM_LAYOUT_IMMORTAL);
+    grim_census_immortal(GRIM_SYMBOL, sizeof(grim_isymbol) + length + 1);
+    sym->symbolhash = hash;
+    sym->symbolname.tag = GRIM_STRING_TAG;
+    sym->symbolname.strhash = (uint32_t) hash;
+    sym->symbolname.sbuf = sym->symbolname.sinline;
+    sym->symbolname.buflen = length;
+    memcpy(sym->symbolname.sinline, name, length);
+    sym->symbolname.sinline[length] = 0;
+    return sym;
+}
+
+static grim_isymbol *grim_symbols_find(const uint8_t *name, size_t length, uint64_t hash) {
+    grim_isymbol *sym = grim_symbols[hash & (grim_symbols_cap - 1)];
+    for (; sym; sym = sym->symbolnext)
+        if (sym->symbolhash == hash && sym->symbolname.buflen == length &&
+            !memcmp(sym->symbolname.sbuf, name, length))
+            return sym;
+    return NULL;
+}
+
+static void grim_symbols_insert(grim_isymbol *sym) {
+    grim_isymbol **bucket = &grim_symbols[sym->symbolhash & (grim_symbols_cap - 1)];
+    sym->symbolnext = *bucket;
+    *bucket = sym;
+    if (++grim_symbols_fill > grim_symbols_cap)
+        grim_symbols_grow();
+}
+
+static grim_object grim_u8intern(const uint8_t *name, size_t length) {
+    uint64_t hash = grim_hash_bytes((const char *) name, length, 0);
+    grim_isymbol *sym = grim_symbols_find(name, length, hash);
+    if (!sym) {
+        sym = grim_symbol_create(name, length, hash);
+        grim_symbols_insert(sym);
+    }
+    return (grim_object) sym | GRIM_SYMBOL_TAG;
+}
+
+grim_object grim_intern(const char *name, const char *encoding) {
+    return grim_nintern(name, strlen(name), encoding);
+}
+
+grim_object grim_nintern(const char *name, size_t length, const char *encoding) {
+    if (!encoding)
+        return grim_u8intern((const uint8_t *) name, length);
+
+    uint8_t workspace[256];
+    size_t u8len = sizeof(workspace);
+    uint8_t *u8str = u8_conv_from_encoding(
+        encoding, iconveh_error, name, length, NULL, workspace, &u8len);
+    assert(u8str);
+    grim_object sym = grim_u8intern(u8str, u8len);
+    if (u8str != workspace)
+        free(u8str);
+    return sym;
+}
+
+
+// Heap images
+// -----------------------------------------------------------------------------
+
+// An image holds a copy of the whole table, chains and all.  When it's
+// the first thing loaded, the table is taken over as it is, and only
+// the bucket array is copied.  Otherwise its symbols are interned one
+// by one, and those whose names are taken are replaced by the symbols
+// already there.
+
+grim_isymbol **grim_symbols_table(size_t *cap, size_t *fill) {
+    *cap = grim_symbols_cap;
+    *fill = grim_symbols_fill;
+    return grim_symbols;
+}
+
+void grim_symbols_adopt(grim_isymbol *const *buckets, size_t cap, size_t fill) {
+    assert(!grim_symbols);
+    grim_symbols = malloc(cap * sizeof(grim_isymbol *));
+    assert(grim_symbols);
+    memcpy(grim_symbols, buckets, cap * sizeof(grim_isymbol *));
+    grim_symbols_cap = cap;
+    grim_symbols_fill = fill;
+}
+
+grim_isymbol *grim_symbols_merge(grim_isymbol *sym) {
+    grim_isymbol *existing = grim_symbols_find(
+        sym->symbolname.sbuf, sym->symbolname.buflen, sym->symbolhash);
+    if (existing)
+        return existing;
+    grim_symbols_insert(sym);
+    return sym;
+}
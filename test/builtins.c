@@ -38,12 +38,182 @@ static MunitResult add(const MunitParameter params[], void *fixture) {
     a = grim_call_2(func, a, grim_integer_pack(GRIM_FIXNUM_MAX));
     gta_check_fixnum(a, -2);
 
+    a = grim_call_2(func, grim_integer_pack(1), grim_rational_pack(grim_integer_pack(1), grim_integer_pack(2)));
+    gta_is_rational(a);
+    gta_check_fixnum(grim_rational_num(a), 3);
+    gta_check_fixnum(grim_rational_den(a), 2);
+
+    a = grim_call_2(func, grim_rational_pack(grim_integer_pack(1), grim_integer_pack(3)), grim_integer_pack(2));
+    gta_is_rational(a);
+    gta_check_fixnum(grim_rational_num(a), 7);
+    gta_check_fixnum(grim_rational_den(a), 3);
+
+    return MUNIT_OK;
+}
+
+static MunitResult sub(const MunitParameter params[], void *fixture) {
+    grim_object a, func = builtin("-");
+
+    a = grim_call_2(func, grim_integer_pack(1), grim_integer_pack(3));
+    gta_check_fixnum(a, -2);
+
+    a = grim_call_2(func, grim_integer_pack(1), grim_rational_pack(grim_integer_pack(1), grim_integer_pack(2)));
+    gta_is_rational(a);
+    gta_check_fixnum(grim_rational_num(a), 1);
+    gta_check_fixnum(grim_rational_den(a), 2);
+
+    a = grim_call_2(func, grim_rational_pack(grim_integer_pack(1), grim_integer_pack(3)), grim_integer_pack(2));
+    gta_is_rational(a);
+    gta_check_fixnum(grim_rational_num(a), -5);
+    gta_check_fixnum(grim_rational_den(a), 3);
+
+    return MUNIT_OK;
+}
+
+static MunitResult vector_copy(const MunitParameter params[], void *fixture) {
+    grim_object func = builtin("vector-copy!");
+    grim_object src = grim_vector_create(5), dest = grim_vector_create(5);
+    for (int i = 0; i < 5; i++)
+        I_vectorelt(src, i) = grim_integer_pack(i);
+
+    grim_object args[5] = {dest, grim_integer_pack(1), src, grim_integer_pack(2), grim_integer_pack(4)};
+    grim_call(func, 5, args);
+    gta_is_undefined(I_vectorelt(dest, 0));
+    gta_check_fixnum(I_vectorelt(dest, 1), 2);
+    gta_check_fixnum(I_vectorelt(dest, 2), 3);
+    gta_is_undefined(I_vectorelt(dest, 3));
+
+    grim_call(func, 3, (grim_object[]) {dest, grim_integer_pack(0), src});
+    for (int i = 0; i < 5; i++)
+        gta_check_fixnum(I_vectorelt(dest, i), i);
+
+    return MUNIT_OK;
+}
+
+static MunitResult vector_fill(const MunitParameter params[], void *fixture) {
+    grim_object func = builtin("vector-fill!");
+    grim_object vec = grim_vector_create(5);
+
+    grim_call_2(func, vec, grim_true);
+    for (int i = 0; i < 5; i++)
+        gta_is_true(I_vectorelt(vec, i));
+
+    grim_call(func, 4, (grim_object[]) {vec, grim_false, grim_integer_pack(1), grim_integer_pack(3)});
+    gta_is_true(I_vectorelt(vec, 0));
+    gta_is_false(I_vectorelt(vec, 1));
+    gta_is_false(I_vectorelt(vec, 2));
+    gta_is_true(I_vectorelt(vec, 3));
+
+    grim_call(func, 3, (grim_object[]) {vec, grim_nil, grim_integer_pack(4)});
+    gta_is_true(I_vectorelt(vec, 3));
+    gta_is_nil(I_vectorelt(vec, 4));
+
+    return MUNIT_OK;
+}
+
+static grim_object visited;
+
+// Records its arguments, and returns the value plus one
+static grim_object visit(int nargs, const grim_object *args) {
+    (void) nargs;
+    visited = grim_cons_pack(grim_cons_pack(args[0], args[1]), visited);
+    return grim_add(args[1], grim_integer_pack(1), false);
+}
+
+static grim_object ordered_table() {
+    grim_object table = grim_hashtable_create(0);
+    for (intmax_t i = 0; i < 20; i++)
+        grim_hashtable_set(table, grim_integer_pack(i * 37 % 101), grim_integer_pack(i));
+    grim_hashtable_unset(table, grim_integer_pack(37));
+    grim_hashtable_set(table, grim_integer_pack(0), grim_integer_pack(100));
+    return table;
+}
+
+// Checks that visited holds the entries of ordered_table, newest first
+static void check_visited() {
+    grim_object entry = visited;
+    for (intmax_t i = 19; i >= 0; i--) {
+        if (i == 1)
+            continue;
+        gta_is_cons(entry);
+        gta_check_fixnum(I_car(I_car(entry)), i * 37 % 101);
+        gta_check_fixnum(I_cdr(I_car(entry)), i ? i : 100);
+        entry = I_cdr(entry);
+    }
+    gta_is_nil(entry);
+}
+
+static MunitResult hashtable_for_each(const MunitParameter params[], void *fixture) {
+    grim_object table = ordered_table();
+    visited = grim_nil;
+    gta_is_undefined(grim_call_2(builtin("hashtable-for-each"), grim_cfunc_create(visit, 2, false), table));
+    check_visited();
+    return MUNIT_OK;
+}
+
+static MunitResult hashtable_map(const MunitParameter params[], void *fixture) {
+    grim_object table = ordered_table();
+    visited = grim_nil;
+    grim_object result = grim_call_2(builtin("hashtable-map"), grim_cfunc_create(visit, 2, false), table);
+    check_visited();
+    gta_check_hashtable(result, 19);
+    gta_check_fixnum(grim_hashtable_get(result, grim_integer_pack(0)), 101);
+    gta_check_fixnum(grim_hashtable_get(result, grim_integer_pack(74)), 3);
+    gta_check_fixnum(grim_hashtable_get(table, grim_integer_pack(74)), 2);
+
+    // The new table is in the same order
+    visited = grim_nil;
+    grim_call_2(builtin("hashtable-for-each"), grim_cfunc_create(visit, 2, false), table);
+    grim_object expected = visited;
+    visited = grim_nil;
+    grim_call_2(builtin("hashtable-for-each"), grim_cfunc_create(visit, 2, false), result);
+    for (grim_object a = expected, b = visited; a != grim_nil; a = I_cdr(a), b = I_cdr(b))
+        munit_assert(I_car(I_car(a)) == I_car(I_car(b)));
+    return MUNIT_OK;
+}
+
+static grim_object assoc(grim_object alist, const char *name) {
+    grim_object key = grim_intern(name, NULL);
+    for (; grim_type(alist) == GRIM_CONS; alist = I_cdr(alist))
+        if (I_car(I_car(alist)) == key)
+            return I_cdr(I_car(alist));
+    return grim_undefined;
+}
+
+static MunitResult heap_stats(const MunitParameter params[], void *fixture) {
+    grim_object keep = grim_cons_pack(grim_nil, grim_nil);
+    grim_object stats = grim_call_0(builtin("heap-stats"));
+
+    grim_object conses = assoc(stats, "cons");
+    gta_is_cons(conses);
+    gta_is_fixnum(I_car(conses));
+    munit_assert_llong(grim_integer_extract(I_car(conses)), >=, 1);
+    gta_is_cons(I_cdr(conses));
+    gta_is_fixnum(I_car(I_cdr(conses)));
+    gta_is_nil(I_cdr(I_cdr(conses)));
+
+    gta_is_fixnum(assoc(stats, "heap-bytes"));
+    gta_is_fixnum(assoc(stats, "gc-count"));
+    munit_assert_llong(grim_integer_extract(assoc(stats, "gc-count")), >=, 1);
+    gta_is_float(assoc(stats, "gc-pause-total"));
+    gta_is_float(assoc(stats, "gc-pause-max"));
+
+    // Types with nothing live are left out
+    gta_is_undefined(assoc(stats, "character"));
+
+    gta_is_cons(keep);
     return MUNIT_OK;
 }
 
 
 MunitTest tests_builtins[] = {
     gta_basic(add),
+    gta_basic(sub),
+    gta_basic(vector_copy),
+    gta_basic(vector_fill),
+    gta_basic(hashtable_for_each),
+    gta_basic(hashtable_map),
+    gta_basic(heap_stats),
     gta_endtests,
 };
 
@@ -1,3 +1,11 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/wait.h>
+
+#include "gc.h"
+
 #include "grim.h"
 #include "internal.h"
 #include "test.h"
@@ -127,6 +135,185 @@ static MunitResult delete(const MunitParameter params[], void *fixture) {
     return MUNIT_OK;
 }
 
+static MunitResult direct(const MunitParameter params[], void *fixture) {
+    grim_object keys[] = {
+        grim_integer_pack(0), grim_integer_pack(1), grim_integer_pack(-1),
+        grim_float_pack(0.5), grim_float_pack(2.5), grim_float_pack(0.0),
+        grim_character_pack('a'), grim_character_pack('b'),
+        grim_nil, grim_true, grim_false,
+        grim_intern("alpha", NULL), grim_intern("beta", NULL),
+    };
+    size_t nkeys = sizeof(keys) / sizeof(keys[0]);
+
+    grim_object table = grim_hashtable_create(0);
+    for (size_t i = 0; i < nkeys; i++) {
+        munit_assert_true(GRIM_HASHED_BY_IDENTITY(keys[i]));
+        munit_assert_true(grim_hash(keys[i], 0) == grim_hash_identity(keys[i], 0));
+        grim_hashtable_set(table, keys[i], grim_integer_pack(i));
+    }
+    gta_check_hashtable(table, nkeys);
+    for (size_t i = 0; i < nkeys; i++)
+        gta_check_fixnum(grim_hashtable_get(table, keys[i]), i);
+    gta_check_fixnum(grim_hashtable_get(table, grim_intern("alpha", NULL)), 11);
+    gta_is_undefined(grim_hashtable_get(table, grim_integer_pack(2)));
+
+    // Strings aren't, even next to symbols of the same name, and
+    // neither are floats that don't fit in a word
+    grim_object name = grim_string_pack("alpha", NULL, false);
+    munit_assert_false(GRIM_HASHED_BY_IDENTITY(name));
+    gta_is_undefined(grim_hashtable_get(table, name));
+    grim_hashtable_set(table, name, grim_true);
+    munit_assert_true(grim_hashtable_get(table, grim_string_pack("alpha", NULL, false)) == grim_true);
+    gta_check_fixnum(grim_hashtable_get(table, keys[11]), 11);
+
+    grim_object zero = grim_float_pack(-0.0);
+    munit_assert_false(GRIM_HASHED_BY_IDENTITY(zero));
+    grim_hashtable_set(table, zero, grim_false);
+    munit_assert_true(grim_hashtable_get(table, grim_float_pack(-0.0)) == grim_false);
+    gta_check_fixnum(grim_hashtable_get(table, grim_float_pack(0.0)), 5);
+    return MUNIT_OK;
+}
+
+static grim_object read_one(const char *str) {
+    return grim_read(grim_string_pack(str, NULL, false));
+}
+
+// Makes a list of the given integers that loops back to its start
+static grim_object make_cycle(const int *elts, size_t n) {
+    grim_object head = grim_nil;
+    for (size_t i = n; i > 0; i--)
+        head = grim_cons_pack(grim_integer_pack(elts[i - 1]), head);
+    grim_object last = head;
+    while (I_cdr(last) != grim_nil)
+        last = I_cdr(last);
+    I_cdr(last) = head;
+    return head;
+}
+
+// Anything can be a key, and structures are equal to their copies
+static MunitResult structural(const MunitParameter params[], void *fixture) {
+    const char *keys[] = {
+        "(1 2 3)", "(2 1 3)", "((1) 2 3)", "(1 (2 3))", "(1 2 . 3)", "(a \"b\" #\\c)", "()",
+        "#(1 2 3)", "#((1 2) #(3))", "#()", "1/3", "2/3", "1+2i", "1.5+2i",
+        "123456789012345678901234567890", "1e300", "\"(1 2 3)\"",
+    };
+    size_t nkeys = sizeof(keys) / sizeof(keys[0]);
+
+    grim_object table = grim_hashtable_create(0);
+    for (size_t i = 0; i < nkeys; i++)
+        grim_hashtable_set(table, read_one(keys[i]), grim_integer_pack(i));
+    gta_check_hashtable(table, nkeys);
+    for (size_t i = 0; i < nkeys; i++) {
+        grim_object key = read_one(keys[i]);
+        munit_assert_true(grim_hash(key, 0) == grim_hash(read_one(keys[i]), 0));
+        gta_check_fixnum(grim_hashtable_get(table, key), i);
+    }
+    munit_assert_false(GRIM_HASHED_BY_IDENTITY(read_one("(1)")));
+    gta_is_undefined(grim_hashtable_get(table, read_one("(1 2 3 4)")));
+    gta_is_undefined(grim_hashtable_get(table, read_one("#(1 2)")));
+
+    // Memoizing on argument lists
+    grim_object args = grim_cons_pack(grim_intern("f", NULL), grim_cons_pack(grim_integer_pack(3), grim_nil));
+    grim_hashtable_set(table, args, grim_true);
+    munit_assert_true(grim_hashtable_get(table, read_one("(f 3)")) == grim_true);
+
+    // Objects that are only equal to themselves are hashed by address
+    grim_object other = grim_hashtable_create(0);
+    grim_hashtable_set(table, other, grim_false);
+    munit_assert_true(grim_hashtable_get(table, other) == grim_false);
+    gta_is_undefined(grim_hashtable_get(table, grim_hashtable_create(0)));
+    munit_assert_false(grim_equal(read_one("(1 #(2))"), grim_cons_pack(grim_integer_pack(1), other)));
+
+    // Long lists and vectors are only hashed in part, but still told
+    // apart by their ends
+    grim_object longs[3];
+    for (int k = 0; k < 3; k++) {
+        longs[k] = grim_cons_pack(grim_integer_pack(k == 2), grim_nil);
+        for (int i = 0; i < 100000; i++)
+            longs[k] = grim_cons_pack(grim_integer_pack(i), longs[k]);
+    }
+    munit_assert_true(grim_hash(longs[0], 0) == grim_hash(longs[2], 0));
+    munit_assert_true(grim_equal(longs[0], longs[1]));
+    munit_assert_false(grim_equal(longs[0], longs[2]));
+    grim_hashtable_set(table, longs[0], grim_integer_pack(0));
+    grim_hashtable_set(table, longs[2], grim_integer_pack(2));
+    gta_check_fixnum(grim_hashtable_get(table, longs[1]), 0);
+    gta_check_fixnum(grim_hashtable_get(table, longs[2]), 2);
+
+    // Deep nesting doesn't recurse on the C stack
+    grim_object deep[2] = {grim_nil, grim_nil};
+    for (int k = 0; k < 2; k++)
+        for (int i = 0; i < 1000000; i++)
+            deep[k] = grim_cons_pack(deep[k], grim_nil);
+    munit_assert_true(grim_hash(deep[0], 0) == grim_hash(deep[1], 0));
+    munit_assert_true(grim_equal(deep[0], deep[1]));
+
+    // Cycles that unroll to the same list are equal, even if they
+    // have different periods
+    const int one[] = {1, 2, 3}, two[] = {1, 2, 3, 1, 2, 3}, three[] = {1, 2, 4};
+    grim_object cycles[] = {make_cycle(one, 3), make_cycle(two, 6), make_cycle(three, 3)};
+    munit_assert_true(grim_hash(cycles[0], 0) == grim_hash(cycles[1], 0));
+    munit_assert_true(grim_equal(cycles[0], cycles[1]));
+    munit_assert_false(grim_equal(cycles[0], cycles[2]));
+    grim_hashtable_set(table, cycles[0], grim_true);
+    munit_assert_true(grim_hashtable_get(table, cycles[1]) == grim_true);
+    gta_is_undefined(grim_hashtable_get(table, cycles[2]));
+
+    grim_object vec = grim_vector_create(2);
+    I_vectorelt(vec, 0) = vec;
+    I_vectorelt(vec, 1) = cycles[1];
+    grim_object copy = grim_vector_create(2);
+    I_vectorelt(copy, 0) = vec;
+    I_vectorelt(copy, 1) = cycles[0];
+    munit_assert_true(grim_hash(vec, 0) == grim_hash(copy, 0));
+    munit_assert_true(grim_equal(vec, copy));
+    return MUNIT_OK;
+}
+
+// Negative bignums keep their sign apart from their limbs
+static MunitResult negative(const MunitParameter params[], void *fixture) {
+    const char *keys[] = {
+        "123456789012345678901234567890", "-123456789012345678901234567890",
+        "1/2", "-1/2", "-123456789012345678901234567890/7",
+        "1+2i", "-1-2i", "-1.5-2i", "-123456789012345678901234567890-1/2i",
+    };
+    size_t nkeys = sizeof(keys) / sizeof(keys[0]);
+
+    grim_object table = grim_hashtable_create(0);
+    for (size_t i = 0; i < nkeys; i++)
+        grim_hashtable_set(table, read_one(keys[i]), grim_integer_pack(i));
+    gta_check_hashtable(table, nkeys);
+    for (size_t i = 0; i < nkeys; i++)
+        gta_check_fixnum(grim_hashtable_get(table, read_one(keys[i])), i);
+
+    munit_assert_true(grim_hash(read_one(keys[0]), 0) != grim_hash(read_one(keys[1]), 0));
+    munit_assert_true(grim_hash(read_one(keys[2]), 0) != grim_hash(read_one(keys[3]), 0));
+    return MUNIT_OK;
+}
+
+// Every length takes a different path through grim_hash_bytes, and
+// each of them should see every byte and the seed
+static MunitResult hash_bytes(const MunitParameter params[], void *fixture) {
+    char buf[300];
+    for (size_t i = 0; i < sizeof(buf); i++)
+        buf[i] = (char) i;
+
+    uint64_t prev = grim_hash_bytes(buf, 0, 0);
+    for (size_t len = 1; len < sizeof(buf); len++) {
+        uint64_t h = grim_hash_bytes(buf, len, 0);
+        munit_assert_true(h == grim_hash_bytes(buf, len, 0));
+        munit_assert_true(h != prev);
+        munit_assert_true(h != grim_hash_bytes(buf, len, 1));
+        for (size_t i = 0; i < len; i++) {
+            buf[i] ^= 0x10;
+            munit_assert_true(h != grim_hash_bytes(buf, len, 0));
+            buf[i] ^= 0x10;
+        }
+        prev = h;
+    }
+    return MUNIT_OK;
+}
+
 static MunitResult stress(const MunitParameter params[], void *fixture) {
     grim_object table = grim_hashtable_create(0);
     for (intmax_t i = 0; i < 4000; i++)
@@ -137,12 +324,486 @@ static MunitResult stress(const MunitParameter params[], void *fixture) {
     return MUNIT_OK;
 }
 
+static MunitResult churn(const MunitParameter params[], void *fixture) {
+    // Deleted slots are reused, or cleaned up, rather than growing the
+    // table forever
+    grim_object table = grim_hashtable_create(0);
+    for (intmax_t round = 0; round < 50; round++) {
+        for (intmax_t i = 0; i < 500; i++)
+            grim_hashtable_set(table, grim_integer_pack(round * 500 + i), grim_integer_pack(i));
+        gta_check_hashtable(table, 500);
+        for (intmax_t i = 0; i < 500; i++) {
+            gta_check_fixnum(grim_hashtable_get(table, grim_integer_pack(round * 500 + i)), i);
+            grim_hashtable_unset(table, grim_integer_pack(round * 500 + i));
+        }
+        gta_check_hashtable(table, 0);
+    }
+    munit_assert_size(I_hashcap(table), <=, 2048);
+
+    // Strings, symbols and numbers side by side, across several resizes
+    for (intmax_t i = 0; i < 3000; i++) {
+        char name[32];
+        snprintf(name, sizeof(name), "key-%jd", i);
+        grim_hashtable_set(table, grim_string_pack(name, NULL, false), grim_integer_pack(i));
+        grim_hashtable_set(table, grim_intern(name, NULL), grim_integer_pack(-i));
+    }
+    gta_check_hashtable(table, 6000);
+    for (intmax_t i = 0; i < 3000; i++) {
+        char name[32];
+        snprintf(name, sizeof(name), "key-%jd", i);
+        gta_check_fixnum(grim_hashtable_get(table, grim_string_pack(name, NULL, false)), i);
+        gta_check_fixnum(grim_hashtable_get(table, grim_intern(name, NULL)), -i);
+    }
+    return MUNIT_OK;
+}
+
+static MunitResult incremental(const MunitParameter params[], void *fixture) {
+    // Fill the table until it starts growing, and is big enough for
+    // that to take a while
+    grim_object table = grim_hashtable_create(0);
+    intmax_t n = 0;
+    while (I_hasholdslots(table)->cap < 4096) {
+        grim_hashtable_set(table, grim_integer_pack(n), grim_integer_pack(n));
+        n++;
+    }
+    size_t oldcap = I_hasholdslots(table)->cap;
+    munit_assert_size(I_hashcap(table), ==, 2 * oldcap);
+    munit_assert_size(I_hashmigrated(table), <, oldcap);
+
+    // Entries still in the old slots can be found, changed and deleted
+    for (intmax_t i = 0; i < n; i++)
+        gta_check_fixnum(grim_hashtable_get(table, grim_integer_pack(i)), i);
+    for (intmax_t i = 0; i < n; i += 3)
+        grim_hashtable_set(table, grim_integer_pack(i), grim_integer_pack(-i));
+    for (intmax_t i = 1; i < n; i += 3)
+        grim_hashtable_unset(table, grim_integer_pack(i));
+    munit_assert_size(I_hasholdslots(table)->cap, ==, 0);
+
+    intmax_t count = 0;
+    for (intmax_t i = 0; i < n; i++) {
+        grim_object value = grim_hashtable_get(table, grim_integer_pack(i));
+        if (i % 3 == 1)
+            gta_is_undefined(value);
+        else {
+            gta_check_fixnum(value, i % 3 == 0 ? -i : i);
+            count++;
+        }
+    }
+    gta_check_hashtable(table, count);
+
+    // A table that is growing can be saved
+    while (!I_hasholdslots(table)->cap) {
+        grim_hashtable_set(table, grim_integer_pack(n), grim_integer_pack(n));
+        n++;
+        count++;
+    }
+    char path[] = "/tmp/grimtest-XXXXXX";
+    gt_save_temporary(path, table);
+    grim_object loaded = grim_image_load(path);
+    unlink(path);
+    gta_check_hashtable(loaded, count);
+    munit_assert_size(I_hasholdslots(loaded)->cap, ==, 0);
+    for (intmax_t i = 0; i < n; i++)
+        munit_assert_true(grim_hashtable_get(loaded, grim_integer_pack(i)) == grim_hashtable_get(table, grim_integer_pack(i)));
+    return MUNIT_OK;
+}
+
+static MunitResult small(const MunitParameter params[], void *fixture) {
+    grim_object table = grim_hashtable_create(0);
+    grim_object keys[] = {
+        grim_string_pack("alpha", NULL, false),
+        grim_intern("beta", NULL),
+        grim_integer_pack(3),
+        grim_character_pack_name("space", NULL),
+    };
+    size_t cap = I_hashcap(table);
+    munit_assert_size(cap, <, GRIM_HASHTABLE_GROUP);
+
+    // Deleting and inserting again doesn't use up room
+    for (intmax_t round = 0; round < 100; round++) {
+        for (intmax_t i = 0; i < 4; i++)
+            grim_hashtable_set(table, keys[i], grim_integer_pack(round + i));
+        gta_check_hashtable(table, 4);
+        grim_hashtable_set(table, grim_string_pack("alpha", NULL, false), grim_integer_pack(-round));
+        gta_check_fixnum(grim_hashtable_get(table, keys[0]), -round);
+        for (intmax_t i = 1; i < 4; i++)
+            gta_check_fixnum(grim_hashtable_get(table, keys[i]), round + i);
+        gta_is_undefined(grim_hashtable_get(table, grim_intern("gamma", NULL)));
+        for (intmax_t i = 0; i < 4; i++)
+            grim_hashtable_unset(table, keys[i]);
+        gta_check_hashtable(table, 0);
+    }
+    munit_assert_size(I_hashcap(table), ==, cap);
+
+    // Outgrowing it
+    for (intmax_t i = 0; i < 100; i++)
+        grim_hashtable_set(table, grim_integer_pack(i), grim_integer_pack(-i));
+    munit_assert_size(I_hashcap(table), >=, GRIM_HASHTABLE_GROUP);
+    for (intmax_t i = 0; i < 100; i++)
+        gta_check_fixnum(grim_hashtable_get(table, grim_integer_pack(i)), -i);
+    gta_check_hashtable(table, 100);
+
+    // A small table takes little room
+    grim_heap_stats_t before, after;
+    grim_heap_stats(&before);
+    grim_object tables = grim_vector_create(100);
+    for (size_t i = 0; i < 100; i++) {
+        I_vectorelt(tables, i) = grim_hashtable_create(0);
+        for (intmax_t j = 0; j < 3; j++)
+            grim_hashtable_set(I_vectorelt(tables, i), keys[j], grim_true);
+    }
+    grim_heap_stats(&after);
+    munit_assert_size(after.types[GRIM_HASHTABLE].count - before.types[GRIM_HASHTABLE].count, ==, 100);
+    munit_assert_size(after.types[GRIM_HASHTABLE].bytes - before.types[GRIM_HASHTABLE].bytes, <, 100 * 512);
+    GC_reachable_here(table);
+    GC_reachable_here(tables);
+    return MUNIT_OK;
+}
+
+static MunitResult collect(const MunitParameter params[], void *fixture) {
+    grim_object table = grim_hashtable_create(0);
+    for (intmax_t i = 0; i < 4000; i++)
+        grim_hashtable_set(table, grim_integer_pack(i), grim_cons_pack(grim_integer_pack(i), grim_nil));
+    GC_gcollect();
+    for (intmax_t i = 0; i < 4000; i++)
+        grim_cons_pack(grim_nil, grim_nil);
+    for (intmax_t i = 0; i < 4000; i++) {
+        grim_object value = grim_hashtable_get(table, grim_integer_pack(i));
+        gta_is_cons(value);
+        gta_check_fixnum(I_car(value), i);
+    }
+    return MUNIT_OK;
+}
+
+// Entries with live keys or values, counted without purging anything
+static size_t count_live(grim_object table) {
+    size_t count = 0;
+    grim_object key, value;
+    for (size_t pos = 0; grim_hashtable_next(table, &pos, &key, &value);)
+        count++;
+    return count;
+}
+
+// Kept out of line, so that no stray pointers to the garbage stay on
+// the stack
+static __attribute__((noinline)) void add_garbage(grim_object table, bool keys, intmax_t n) {
+    for (intmax_t i = 0; i < n; i++) {
+        grim_object obj = grim_cons_pack(grim_integer_pack(i), grim_nil);
+        if (keys)
+            grim_hashtable_set(table, obj, grim_integer_pack(i));
+        else
+            grim_hashtable_set(table, grim_integer_pack(-i - 1), obj);
+    }
+}
+
+static MunitResult weak_keys(const MunitParameter params[], void *fixture) {
+    grim_object table = grim_hashtable_create_weak(0, GRIM_WEAK_KEYS);
+    grim_object keep = grim_vector_create(100);
+    for (intmax_t i = 0; i < 100; i++) {
+        I_vectorelt(keep, i) = grim_cons_pack(grim_integer_pack(i), grim_nil);
+        grim_hashtable_set(table, I_vectorelt(keep, i), grim_integer_pack(i));
+    }
+    // Never collected, so never dropped
+    grim_hashtable_set(table, grim_integer_pack(12345), grim_cons_pack(grim_nil, grim_nil));
+    grim_hashtable_set(table, grim_intern("symbol", NULL), grim_true);
+
+    add_garbage(table, true, 1000);
+    GC_gcollect();
+
+    munit_assert_size(count_live(table), <, 300);
+    for (intmax_t i = 0; i < 100; i++)
+        gta_check_fixnum(grim_hashtable_get(table, I_vectorelt(keep, i)), i);
+    gta_is_cons(grim_hashtable_get(table, grim_integer_pack(12345)));
+    gta_is_true(grim_hashtable_get(table, grim_intern("symbol", NULL)));
+
+    GC_reachable_here(keep);
+    return MUNIT_OK;
+}
+
+static MunitResult weak_values(const MunitParameter params[], void *fixture) {
+    grim_object table = grim_hashtable_create_weak(0, GRIM_WEAK_VALUES);
+    grim_object keep = grim_vector_create(100);
+    for (intmax_t i = 0; i < 100; i++) {
+        I_vectorelt(keep, i) = grim_cons_pack(grim_integer_pack(i), grim_nil);
+        grim_hashtable_set(table, grim_integer_pack(i), I_vectorelt(keep, i));
+    }
+    add_garbage(table, false, 1000);
+    GC_gcollect();
+
+    size_t nfound = 0;
+    for (intmax_t i = 0; i < 1000; i++)
+        nfound += grim_hashtable_get(table, grim_integer_pack(-i - 1)) != grim_undefined;
+    munit_assert_size(nfound, <, 200);
+    for (intmax_t i = 0; i < 100; i++)
+        munit_assert_true(grim_hashtable_get(table, grim_integer_pack(i)) == I_vectorelt(keep, i));
+
+    // Replacing a value moves the weak reference along with it
+    grim_object value = grim_cons_pack(grim_nil, grim_nil);
+    grim_hashtable_set(table, grim_integer_pack(0), value);
+    I_vectorelt(keep, 0) = grim_nil;
+    GC_gcollect();
+    munit_assert_true(grim_hashtable_get(table, grim_integer_pack(0)) == value);
+
+    GC_reachable_here(value);
+    GC_reachable_here(keep);
+    return MUNIT_OK;
+}
+
+static MunitResult weak_bounded(const MunitParameter params[], void *fixture) {
+    // A cache keyed by short-lived objects stays small, as it's purged
+    // before it grows
+    grim_object table = grim_hashtable_create_weak(0, GRIM_WEAK_KEYS);
+    for (int round = 0; round < 50; round++) {
+        add_garbage(table, true, 2000);
+        GC_gcollect();
+    }
+    munit_assert_size(I_hashcap(table), <, 20000);
+    munit_assert_size(I_hashfill(table), <, 20000);
+    return MUNIT_OK;
+}
+
+// The keys kept in the image stay, and of those added afterwards, most
+// are dropped
+static void check_weak_image(grim_object root) {
+    grim_object table = I_car(root), keep = I_cdr(root);
+    add_garbage(table, true, 1000);
+    GC_gcollect();
+    munit_assert_size(count_live(table), <, 300);
+    for (intmax_t i = 0; i < 100; i++)
+        gta_check_fixnum(grim_hashtable_get(table, I_vectorelt(keep, i)), i);
+}
+
+// Runs without setup: the image is saved by a child, so that this
+// process can start from it.  A weak table loaded from an image has
+// room to spare, which must not hold on to what it's given.
+static MunitResult weak_image(const MunitParameter params[], void *fixture) {
+    char path[] = "/tmp/grimtest-XXXXXX";
+    gt_temporary(path);
+    pid_t pid = fork();
+    munit_assert_int(pid, >=, 0);
+    if (pid == 0) {
+        grim_init();
+        grim_object table = grim_hashtable_create_weak(2000, GRIM_WEAK_KEYS);
+        grim_object keep = grim_vector_create(100);
+        for (intmax_t i = 0; i < 100; i++) {
+            I_vectorelt(keep, i) = grim_cons_pack(grim_integer_pack(i), grim_nil);
+            grim_hashtable_set(table, I_vectorelt(keep, i), grim_integer_pack(i));
+        }
+        _exit(grim_image_save(path, grim_cons_pack(table, keep)) ? 0 : 1);
+    }
+    int status;
+    munit_assert_int(waitpid(pid, &status, 0), ==, pid);
+    munit_assert_true(WIFEXITED(status) && WEXITSTATUS(status) == 0);
+
+    grim_object root = grim_init_image(path);
+    munit_assert_true(root != grim_undefined);
+    check_weak_image(root);
+    root = grim_image_load(path);
+    unlink(path);
+    check_weak_image(root);
+    return MUNIT_OK;
+}
+
+// Checks that the keys of a table are the given fixnums, in order
+static void check_order(grim_object table, const intmax_t *keys, size_t n) {
+    grim_object key, value;
+    size_t i = 0;
+    for (size_t pos = 0; grim_hashtable_next(table, &pos, &key, &value); i++) {
+        munit_assert_size(i, <, n);
+        gta_check_fixnum(key, keys[i]);
+    }
+    munit_assert_size(i, ==, n);
+}
+
+// Frees atomic memory of many sizes, full of nonzero bytes, for the
+// next allocations to be given
+static void dirty_atomic() {
+    static void *blocks[16];
+    for (size_t size = 16; size <= 1 << 17; size *= 2) {
+        for (int i = 0; i < 16; i++) {
+            blocks[i] = GC_MALLOC_ATOMIC(size);
+            memset(blocks[i], 0x41, size);
+        }
+        for (int i = 0; i < 16; i++)
+            GC_FREE(blocks[i]);
+    }
+}
+
+static MunitResult ordered(const MunitParameter params[], void *fixture) {
+    static intmax_t keys[4000];
+    size_t n = 0;
+    grim_object table = grim_hashtable_create(0);
+
+    // In order while growing, and after
+    while (!I_hasholdslots(table)->cap || n < 1000) {
+        keys[n] = (intmax_t) (n * 7919) % 10007;
+        grim_hashtable_set(table, grim_integer_pack(keys[n]), grim_integer_pack(n));
+        n++;
+        if (I_hasholdslots(table)->cap)
+            check_order(table, keys, n);
+    }
+    check_order(table, keys, n);
+
+    // Changing a value keeps its place, and a key that is removed and
+    // added again goes last
+    grim_hashtable_set(table, grim_integer_pack(keys[0]), grim_false);
+    size_t m = 0;
+    for (size_t i = 0; i < n; i++)
+        if (i % 3 == 1)
+            grim_hashtable_unset(table, grim_integer_pack(keys[i]));
+        else
+            keys[m++] = keys[i];
+    grim_hashtable_unset(table, grim_integer_pack(keys[1]));
+    grim_hashtable_set(table, grim_integer_pack(keys[1]), grim_true);
+    intmax_t moved = keys[1];
+    memmove(&keys[1], &keys[2], (m - 2) * sizeof(intmax_t));
+    keys[m - 1] = moved;
+    check_order(table, keys, m);
+    gta_is_false(grim_hashtable_get(table, grim_integer_pack(keys[0])));
+
+    // And as it grows again, leaving the holes behind
+    for (intmax_t i = 0; m < 3000; i++)
+        if (!grim_hashtable_has(table, grim_integer_pack(20000 + i))) {
+            keys[m++] = 20000 + i;
+            grim_hashtable_set(table, grim_integer_pack(20000 + i), grim_true);
+        }
+    check_order(table, keys, m);
+
+    // And kept in an image
+    char path[] = "/tmp/grimtest-XXXXXX";
+    gt_save_temporary(path, table);
+    grim_object loaded = grim_image_load(path);
+    unlink(path);
+    check_order(loaded, keys, m);
+    munit_assert_size(I_hashslots(loaded)->used, ==, m);
+
+    // Weak tables too, where entries removed before they are moved leave
+    // holes in the new slots.  Their arrays are given used memory.
+    grim_object weak = grim_hashtable_create_weak(0, GRIM_WEAK_BOTH);
+    for (n = 0; n < 2000 || !I_hasholdslots(weak)->cap; n++) {
+        keys[n] = (intmax_t) (n * 7919) % 10007;
+        if (I_hashslots(weak)->used == GRIM_HASHTABLE_MAX_FILL(I_hashcap(weak)))
+            dirty_atomic();
+        grim_hashtable_set(weak, grim_integer_pack(keys[n]), grim_integer_pack(n));
+    }
+    m = 0;
+    for (size_t i = 0; i < n; i++)
+        if (i + 30 > n && i % 2)
+            grim_hashtable_unset(weak, grim_integer_pack(keys[i]));
+        else
+            keys[m++] = keys[i];
+    for (n = m; n < 4000; n++) {
+        keys[n] = 20000 + (intmax_t) n;
+        grim_hashtable_set(weak, grim_integer_pack(keys[n]), grim_true);
+    }
+    check_order(weak, keys, n);
+    return MUNIT_OK;
+}
+
+#define SHARED_THREADS (4)
+#define SHARED_KEYS (20000)
+
+typedef struct {
+    grim_object table;
+    intmax_t id;
+    bool ok;
+} shared_worker;
+
+static grim_object shared_key(intmax_t i) {
+    char name[32];
+    snprintf(name, sizeof(name), "key-%jd", i);
+    return grim_string_pack(name, NULL, false);
+}
+
+// Each thread fills and empties a range of keys of its own, and reads
+// those of the others, which are only ever there with the right value
+static void *shared_work(void *data) {
+    shared_worker *wk = data;
+    wk->ok = true;
+    for (int round = 0; round < 3; round++) {
+        for (intmax_t i = wk->id; i < SHARED_KEYS; i += SHARED_THREADS) {
+            grim_hashtable_set(wk->table, shared_key(i), grim_integer_pack(i));
+            grim_object other = grim_hashtable_get(wk->table, shared_key(i ^ 1));
+            wk->ok &= other == grim_undefined || other == grim_integer_pack(i ^ 1);
+            wk->ok &= grim_hashtable_get(wk->table, shared_key(-1)) == grim_true;
+        }
+        for (intmax_t i = wk->id; i < SHARED_KEYS; i += SHARED_THREADS) {
+            wk->ok &= grim_hashtable_get(wk->table, shared_key(i)) == grim_integer_pack(i);
+            if (round < 2)
+                grim_hashtable_unset(wk->table, shared_key(i));
+        }
+    }
+    return NULL;
+}
+
+static MunitResult concurrent(const MunitParameter params[], void *fixture) {
+    grim_object table = grim_hashtable_create_concurrent(0);
+    gta_is_hashtable(table);
+    for (intmax_t i = 0; i < 1000; i++) {
+        grim_hashtable_set(table, shared_key(i), grim_integer_pack(i));
+        grim_hashtable_set(table, grim_integer_pack(i), grim_integer_pack(-i));
+    }
+    for (intmax_t i = 0; i < 1000; i += 2) {
+        grim_hashtable_unset(table, shared_key(i));
+        grim_hashtable_set(table, grim_integer_pack(i), grim_true);
+    }
+    munit_assert_size(count_live(table), ==, 1500);
+    for (intmax_t i = 0; i < 1000; i++) {
+        munit_assert(grim_hashtable_has(table, shared_key(i)) == (i % 2 == 1));
+        grim_object value = grim_hashtable_get(table, grim_integer_pack(i));
+        munit_assert(value == (i % 2 ? grim_integer_pack(-i) : grim_true));
+    }
+
+    // Saved as an ordinary table
+    char path[] = "/tmp/grimtest-XXXXXX";
+    gt_save_temporary(path, table);
+    grim_object loaded = grim_image_load(path);
+    unlink(path);
+    munit_assert_null(I_hashshards(loaded));
+    gta_check_hashtable(loaded, 1500);
+    for (intmax_t i = 1; i < 1000; i += 2)
+        gta_check_fixnum(grim_hashtable_get(loaded, shared_key(i)), i);
+
+#ifdef GC_THREADS
+    table = grim_hashtable_create_concurrent(0);
+    grim_hashtable_set(table, shared_key(-1), grim_true);
+    pthread_t threads[SHARED_THREADS];
+    shared_worker workers[SHARED_THREADS];
+    for (intmax_t t = 0; t < SHARED_THREADS; t++) {
+        workers[t] = (shared_worker) {table, t, false};
+        pthread_create(&threads[t], NULL, shared_work, &workers[t]);
+    }
+    for (int t = 0; t < SHARED_THREADS; t++) {
+        pthread_join(threads[t], NULL);
+        munit_assert_true(workers[t].ok);
+    }
+    munit_assert_size(count_live(table), ==, SHARED_KEYS + 1);
+    for (intmax_t i = 0; i < SHARED_KEYS; i++)
+        gta_check_fixnum(grim_hashtable_get(table, shared_key(i)), i);
+#endif
+    return MUNIT_OK;
+}
+
 MunitTest tests_hashtables[] = {
     gta_basic(insert),
     gta_basic(retrieve),
     gta_basic(overwrite),
     gta_basic(delete),
+    gta_basic(direct),
+    gta_basic(structural),
+    gta_basic(negative),
+    gta_basic(hash_bytes),
     gta_basic(stress),
+    gta_basic(churn),
+    gta_basic(incremental),
+    gta_basic(small),
+    gta_basic(ordered),
+    gta_basic(collect),
+    gta_basic(weak_keys),
+    gta_basic(weak_values),
+    gta_basic(weak_bounded),
+    { "/weak_image", weak_image, NULL, NULL, MUNIT_TEST_OPTION_NONE, NULL },
+    gta_basic(concurrent),
     gta_endtests,
 };
 
@@ -0,0 +1,211 @@
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "gc.h"
+
+#include "grim.h"
+#include "internal.h"
+#include "test.h"
+
+
+#define gta_grew(before, after, type, ncount, nbytes)                          \
+    do {                                                                       \
+        munit_assert_size((after).types[type].count - (before).types[type].count, >=, ncount); \
+        munit_assert_size((after).types[type].bytes - (before).types[type].bytes, >=, nbytes); \
+    } while (0)
+
+
+static MunitResult census(const MunitParameter params[], void *fixture) {
+    grim_heap_stats_t before, after;
+    grim_heap_stats(&before);
+
+    grim_object list = grim_nil;
+    for (intmax_t i = 0; i < 1000; i++)
+        list = grim_cons_pack(grim_integer_pack(i), list);
+
+    grim_object strings = grim_vector_create(100);
+    char text[100];
+    memset(text, 'x', sizeof(text));
+    for (size_t i = 0; i < 100; i++)
+        I_vectorelt(strings, i) = grim_nstring_pack(text, sizeof(text), NULL, false);
+
+    grim_object table = grim_hashtable_create(0);
+    for (intmax_t i = 0; i < 50; i++)
+        grim_hashtable_set(table, grim_integer_pack(i), grim_true);
+
+    grim_heap_stats(&after);
+
+    gta_grew(before, after, GRIM_CONS, 1000, 1000 * sizeof(grim_icons));
+    munit_assert_size(after.types[GRIM_CONS].count - before.types[GRIM_CONS].count, <, 1100);
+    gta_grew(before, after, GRIM_STRING, 100, 100 * (sizeof(grim_istring) + sizeof(text)));
+    gta_grew(before, after, GRIM_VECTOR, 1, 100 * sizeof(grim_object));
+    gta_grew(before, after, GRIM_HASHTABLE, 1, 2 * I_hashcap(table) * sizeof(grim_object));
+
+    // Builtins are immortal, but still counted
+    munit_assert_size(after.types[GRIM_FUNCTION].count, >=, 2);
+    munit_assert_size(after.types[GRIM_SYMBOL].count, >=, 2);
+
+    // Immediate objects take no space
+    munit_assert_size(after.types[GRIM_CHARACTER].count, ==, 0);
+    munit_assert_size(after.types[GRIM_NIL].count, ==, 0);
+
+    munit_assert_size(after.gc_count, >, before.gc_count);
+    munit_assert_double(after.gc_pause_max, >, 0.0);
+    munit_assert_double(after.gc_pause_max, <=, after.gc_pause_total);
+    munit_assert_size(after.heap_bytes, >=, after.free_bytes);
+
+    GC_reachable_here(list);
+    GC_reachable_here(strings);
+    GC_reachable_here(table);
+    return MUNIT_OK;
+}
+
+static MunitResult garbage(const MunitParameter params[], void *fixture) {
+    grim_heap_stats_t before, after;
+    grim_heap_stats(&before);
+    for (intmax_t i = 0; i < 10000; i++)
+        grim_cons_pack(grim_float_pack(1e300), grim_nil);
+    grim_heap_stats(&after);
+
+    munit_assert_size(after.types[GRIM_CONS].count, <, before.types[GRIM_CONS].count + 100);
+    munit_assert_size(after.types[GRIM_FLOAT].count, <, before.types[GRIM_FLOAT].count + 100);
+    return MUNIT_OK;
+}
+
+// The setup has already initialized once, and the collector's hooks
+// must not end up calling themselves
+static MunitResult reinit(const MunitParameter params[], void *fixture) {
+    grim_init();
+    grim_object list = grim_nil;
+    for (intmax_t i = 0; i < 1000; i++)
+        list = grim_cons_pack(grim_integer_pack(i), list);
+
+    grim_heap_stats_t before, after;
+    grim_heap_stats(&before);
+    GC_gcollect();
+    grim_heap_stats(&after);
+    munit_assert_size(after.gc_count, >, before.gc_count);
+    gta_check_fixnum(I_car(list), 999);
+    GC_reachable_here(list);
+    return MUNIT_OK;
+}
+
+static void *cons_one(void *data) {
+    return (void *) grim_cons_pack(grim_nil, grim_nil);
+}
+
+// A thread that exits gives back what's left on its free lists, which
+// would otherwise stay marked for good
+static MunitResult threads(const MunitParameter params[], void *fixture) {
+#ifdef GC_THREADS
+    grim_heap_stats_t before, after;
+    grim_heap_stats(&before);
+    for (int i = 0; i < 256; i++) {
+        pthread_t thread;
+        pthread_create(&thread, NULL, cons_one, NULL);
+        pthread_join(thread, NULL);
+    }
+    grim_heap_stats(&after);
+    munit_assert_size(after.heap_bytes - after.free_bytes, <, before.heap_bytes - before.free_bytes + 256 * 1024);
+#endif
+    return MUNIT_OK;
+}
+
+static size_t profile_count(char **report) {
+    size_t len, count, bytes;
+    FILE *stream = open_memstream(report, &len);
+    grim_profile_report(stream, grim_undefined, 10);
+    fclose(stream);
+    munit_assert_int(sscanf(*report, "Allocation profile: %zu allocations, %zu bytes", &count, &bytes), ==, 2);
+    munit_assert_size(bytes, >=, count * 16);
+    return count;
+}
+
+static MunitResult profile(const MunitParameter params[], void *fixture) {
+    grim_object module = grim_module_create(grim_intern("profiled", NULL));
+    grim_module_set(module, grim_intern("adder", NULL), gt_make_adder());
+    grim_object adder = grim_module_get(module, grim_intern("adder", NULL));
+    grim_object big = grim_integer_read("123456789012345678901234567890", 10);
+
+    grim_profile_start();
+    for (int i = 0; i < 1000; i++)
+        grim_cons_pack(grim_float_pack(1e300), grim_nil);
+    for (int i = 0; i < 100; i++)
+        gta_is_bigint(grim_call_1(adder, big));
+    grim_profile_stop();
+
+    char *report;
+    size_t count = profile_count(&report);
+    munit_assert_size(count, >=, 2000 + 100);
+    munit_assert_not_null(strstr(report, "call site"));
+    munit_assert_null(strstr(report, "adder #<function"));
+    free(report);
+
+    // Nothing is recorded while stopped
+    grim_cons_pack(grim_nil, grim_nil);
+    munit_assert_size(profile_count(&report), ==, count);
+    free(report);
+
+    size_t len;
+    FILE *stream = open_memstream(&report, &len);
+    grim_profile_report(stream, module, 10);
+    fclose(stream);
+    munit_assert_not_null(strstr(report, "adder #<function"));
+    free(report);
+
+    char path[] = "/tmp/grimtest-XXXXXX";
+    gt_temporary(path);
+    munit_assert_true(grim_profile_write_pprof(path));
+    char contents[4096];
+    FILE *file = fopen(path, "r");
+    size_t n = fread(contents, 1, sizeof(contents) - 1, file);
+    contents[n] = 0;
+    fclose(file);
+    unlink(path);
+    munit_assert_int(strncmp(contents, "heap profile:", 13), ==, 0);
+    munit_assert_not_null(strstr(contents, "@ 0x"));
+
+    // Starting again discards the profile
+    grim_profile_start();
+    grim_profile_stop();
+    munit_assert_size(profile_count(&report), ==, 0);
+    free(report);
+
+    // GMP's limbs are counted too, wherever GMP gets them from
+    char digits[2001];
+    memset(digits, '9', 2000);
+    digits[2000] = 0;
+    grim_object huge = grim_integer_read(digits, 10);
+    size_t bytes[2];
+    for (int i = 0; i < 2; i++) {
+        grim_profile_start();
+        gta_is_bigint(grim_call_1(adder, i ? huge : big));
+        grim_profile_stop();
+        profile_count(&report);
+        munit_assert_int(sscanf(report, "Allocation profile: %zu allocations, %zu bytes", &count, &bytes[i]), ==, 2);
+        free(report);
+    }
+    munit_assert_size(bytes[1], >=, bytes[0] + 800);
+
+    return MUNIT_OK;
+}
+
+
+MunitTest tests_heap[] = {
+    gta_basic(census),
+    gta_basic(garbage),
+    gta_basic(reinit),
+    gta_basic(threads),
+    gta_basic(profile),
+    gta_endtests,
+};
+
+MunitSuite suite_heap = {
+    "/heap",
+    tests_heap,
+    NULL,
+    1, MUNIT_SUITE_OPTION_NONE,
+};
@@ -0,0 +1,187 @@
+#include <stdlib.h>
+#include <unistd.h>
+
+#include "gc.h"
+
+#include "grim.h"
+#include "internal.h"
+#include "test.h"
+
+
+static const char source[] =
+    "(%module-set! name \"a string long enough not to be inline\")\n"
+    "(%module-set! short \"abc\")\n"
+    "(%module-set! big 123456789012345678901234567890)\n"
+    "(%module-set! ratio -22/7)\n"
+    "(%module-set! cplx 1.5+2i)\n"
+    "(%module-set! float 1e300)\n"
+    "(%module-set! vec #(1 (a b . c) #(\"x\" 2.5) #u8(1 2 3)))\n"
+    "(%module-set! floats #f64(1.5 -2.5))\n";
+
+// Keyed by structures that hold symbols, and by a function, whose
+// hashes must still hold wherever the image ends up
+static grim_object make_table(grim_object func) {
+    grim_object table = grim_hashtable_create(0);
+    grim_hashtable_set(table, grim_read(grim_string_pack("(a (b 1) . #(c 2.5))", NULL, false)), grim_integer_pack(1));
+    grim_hashtable_set(table, func, grim_integer_pack(2));
+    return table;
+}
+
+static void check_module(grim_object module, grim_object original) {
+    munit_assert_int(grim_type(module), ==, GRIM_MODULE);
+    munit_assert_true(I_modulename(module) == grim_intern("library", NULL));
+
+    const char *names[] = {"name", "short", "big", "float", "floats"};
+    for (size_t i = 0; i < sizeof(names) / sizeof(names[0]); i++) {
+        grim_object name = grim_intern(names[i], NULL);
+        munit_assert_true(grim_equal(grim_module_get(module, name), grim_module_get(original, name)));
+    }
+    gta_check_bigint(grim_module_get(module, grim_intern("big", NULL)), "123456789012345678901234567890");
+
+    grim_object ratio = grim_module_get(module, grim_intern("ratio", NULL));
+    gta_is_rational(ratio);
+    gta_check_fixnum(grim_rational_num(ratio), -22);
+    gta_check_fixnum(grim_rational_den(ratio), 7);
+
+    grim_object cplx = grim_module_get(module, grim_intern("cplx", NULL));
+    gta_is_complex(cplx);
+    gta_check_float(I_real(cplx), 1.5);
+    gta_check_float(I_imag(cplx), 2.0);
+
+    grim_object vec = grim_module_get(module, grim_intern("vec", NULL));
+    gta_check_vector(vec, 4);
+    gta_check_fixnum(I_vectorelt(vec, 0), 1);
+    gta_check_vector(I_vectorelt(vec, 2), 2);
+    gta_check_string(I_vectorelt(I_vectorelt(vec, 2), 0), 1, "x");
+    munit_assert_true(grim_equal(I_vectorelt(vec, 3), grim_read(grim_string_pack("#u8(1 2 3)", NULL, false))));
+
+    // Symbols are the same objects as before
+    grim_object list = I_vectorelt(vec, 1);
+    munit_assert_true(I_car(list) == grim_intern("a", NULL));
+    munit_assert_true(I_car(I_cdr(list)) == grim_intern("b", NULL));
+    munit_assert_true(I_cdr(I_cdr(list)) == grim_intern("c", NULL));
+}
+
+static MunitResult roundtrip(const MunitParameter params[], void *fixture) {
+    grim_object module = grim_build_module(grim_intern("library", NULL), grim_string_pack(source, NULL, false));
+    grim_object root = grim_vector_create(4);
+    I_vectorelt(root, 0) = module;
+    I_vectorelt(root, 1) = gt_make_adder();
+    I_vectorelt(root, 2) = grim_module_get(grim_builtin_module, grim_intern("+", NULL));
+    I_vectorelt(root, 3) = make_table(I_vectorelt(root, 1));
+
+    char path[] = "/tmp/grimtest-XXXXXX";
+    gt_save_temporary(path, root);
+
+    // The second copy can't be mapped where the first one is, so it
+    // has to be relocated
+    grim_object first = grim_image_load(path);
+    grim_object second = grim_image_load(path);
+    unlink(path);
+    munit_assert_true(first != root && second != root && first != second);
+
+    grim_object loaded[] = {first, second};
+    for (int i = 0; i < 2; i++) {
+        gta_check_vector(loaded[i], 4);
+        check_module(I_vectorelt(loaded[i], 0), module);
+        gta_check_fixnum(grim_call_1(I_vectorelt(loaded[i], 1), grim_integer_pack(3)), 8);
+        grim_object add = I_vectorelt(loaded[i], 2);
+        gta_check_fixnum(grim_call_2(add, grim_integer_pack(1), grim_integer_pack(2)), 3);
+        grim_object table = I_vectorelt(loaded[i], 3);
+        grim_object key = grim_read(grim_string_pack("(a (b 1) . #(c 2.5))", NULL, false));
+        gta_check_fixnum(grim_hashtable_get(table, key), 1);
+        gta_check_fixnum(grim_hashtable_get(table, I_vectorelt(loaded[i], 1)), 2);
+    }
+
+    return MUNIT_OK;
+}
+
+static MunitResult mutate(const MunitParameter params[], void *fixture) {
+    grim_object module = grim_build_module(grim_intern("library", NULL), grim_string_pack(source, NULL, false));
+    char path[] = "/tmp/grimtest-XXXXXX";
+    gt_save_temporary(path, module);
+    grim_object loaded = grim_image_load(path);
+    unlink(path);
+
+    // Loaded objects may come to point into the collected heap, and
+    // their payloads may need to grow out of the image
+    grim_object vec = grim_module_get(loaded, grim_intern("vec", NULL));
+    for (int i = 0; i < 100; i++)
+        grim_vector_push(vec, grim_cons_pack(grim_integer_pack(i), grim_nil));
+    for (int i = 0; i < 2000; i++)
+        grim_module_set(loaded, grim_intern("new", NULL), grim_float_pack(1e300 + i));
+    for (int i = 0; i < 2000; i++) {
+        char name[32];
+        snprintf(name, sizeof(name), "sym-%d", i);
+        grim_module_set(loaded, grim_intern(name, NULL), grim_integer_pack(i));
+    }
+
+    GC_gcollect();
+    for (int i = 0; i < 10000; i++)
+        grim_cons_pack(grim_float_pack(1e300), grim_nil);
+    GC_gcollect();
+
+    gta_check_vector(vec, 104);
+    for (int i = 0; i < 100; i++)
+        gta_check_fixnum(I_car(I_vectorelt(vec, 4 + i)), i);
+    munit_assert_double(grim_float_extract(grim_module_get(loaded, grim_intern("new", NULL))), ==, 1e300 + 1999);
+    gta_check_fixnum(grim_module_get(loaded, grim_intern("sym-1234", NULL)), 1234);
+    gta_check_string(grim_module_get(loaded, grim_intern("short", NULL)), 3, "abc");
+
+    return MUNIT_OK;
+}
+
+static MunitResult census(const MunitParameter params[], void *fixture) {
+    grim_heap_stats_t before, after;
+    grim_object vec = grim_vector_create(100);
+    for (int i = 0; i < 100; i++)
+        I_vectorelt(vec, i) = grim_cons_pack(grim_float_pack(1e300), grim_nil);
+
+    char path[] = "/tmp/grimtest-XXXXXX";
+    gt_save_temporary(path, vec);
+    grim_heap_stats(&before);
+    grim_image_load(path);
+    grim_heap_stats(&after);
+    unlink(path);
+
+    munit_assert_size(after.types[GRIM_CONS].count - before.types[GRIM_CONS].count, ==, 100);
+    munit_assert_size(after.types[GRIM_FLOAT].count - before.types[GRIM_FLOAT].count, ==, 100);
+    munit_assert_size(after.types[GRIM_VECTOR].count - before.types[GRIM_VECTOR].count, ==, 1);
+    munit_assert_size(after.types[GRIM_SYMBOL].count, >, before.types[GRIM_SYMBOL].count);
+
+    return MUNIT_OK;
+}
+
+static MunitResult failures(const MunitParameter params[], void *fixture) {
+    munit_assert_true(grim_image_load("/nonexistent/grim.image") == grim_undefined);
+
+    // Not an image
+    char path[] = "/tmp/grimtest-XXXXXX";
+    int fd = mkstemp(path);
+    munit_assert_int(write(fd, "hello world", 11), ==, 11);
+    close(fd);
+    munit_assert_true(grim_image_load(path) == grim_undefined);
+
+    // Frames can't be saved
+    grim_object frame = grim_frame_create(gt_make_adder(), grim_undefined);
+    munit_assert_false(grim_image_save(path, grim_cons_pack(frame, grim_nil)));
+    unlink(path);
+
+    return MUNIT_OK;
+}
+
+
+MunitTest tests_image[] = {
+    gta_basic(roundtrip),
+    gta_basic(mutate),
+    gta_basic(census),
+    gta_basic(failures),
+    gta_endtests,
+};
+
+MunitSuite suite_image = {
+    "/image",
+    tests_image,
+    NULL,
+    1, MUNIT_SUITE_OPTION_NONE,
+};
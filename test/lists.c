@@ -2,6 +2,26 @@
 #include "test.h"
 
 
+static MunitResult pack(const MunitParameter params[], void *fixture) {
+    grim_object a = grim_integer_pack(1);
+    grim_object list = grim_cons_pack(a, grim_nil);
+    gta_is_cons(list);
+    munit_assert_int(list & 0x0f, ==, GRIM_CONS_TAG);
+    gta_check_fixnum(I_car(list), 1);
+    gta_check_repr(I_cdr(list), grim_nil);
+
+    grim_object outer = grim_cons_pack(list, list);
+    gta_is_cons(outer);
+    gta_check_repr(I_car(outer), list);
+    gta_check_repr(I_cdr(outer), list);
+
+    munit_assert_int(grim_type(grim_nil), ==, GRIM_NIL);
+    munit_assert_int(grim_type(grim_false), ==, GRIM_BOOLEAN);
+    munit_assert_int(grim_type(grim_undefined), ==, GRIM_UNDEFINED);
+
+    return MUNIT_OK;
+}
+
 static MunitResult read_simple(const MunitParameter params[], void *fixture) {
     grim_object code, list;
 
@@ -100,11 +120,32 @@ static MunitResult read_dotted(const MunitParameter params[], void *fixture) {
     return MUNIT_OK;
 }
 
+static MunitResult read_all(const MunitParameter params[], void *fixture) {
+    grim_object code, list;
+
+    code = grim_string_pack("1.5 (a 12345678901234567890123) #e1.25 (b . 2)", "UTF-8", false);
+    list = grim_read_all(code);
+    gta_is_cons(list);
+    gta_check_float(I_car(list), 1.5); list = I_cdr(list);
+    gta_is_cons(I_car(list));
+    gta_check_bigint(I_car(I_cdr(I_car(list))), "12345678901234567890123"); list = I_cdr(list);
+    gta_is_rational(I_car(list)); list = I_cdr(list);
+    gta_check_fixnum(I_cdr(I_car(list)), 2);
+    gta_check_repr(I_cdr(list), grim_nil);
+
+    code = grim_string_pack("1 2 )", "UTF-8", false);
+    gta_check_repr(grim_read_all(code), grim_undefined);
+
+    return MUNIT_OK;
+}
+
 
 static MunitTest tests_lists[] = {
+    gta_test("pack", pack),
     gta_test("simple", read_simple),
     gta_test("multi", read_multi),
     gta_test("dotted", read_dotted),
+    gta_test("all", read_all),
     gta_endtests,
 };
 
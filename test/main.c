@@ -1,3 +1,6 @@
+#include <stdlib.h>
+#include <unistd.h>
+
 #include "test.h"
 
 int main(int argc, char * const *argv) {
@@ -8,9 +11,12 @@ int main(int argc, char * const *argv) {
         suite_symbols,
         suite_lists,
         suite_vectors,
+        suite_numvectors,
         suite_hashtables,
         suite_builtins,
         suite_bytecode,
+        suite_heap,
+        suite_image,
         gta_endsuite,
     };
 
@@ -22,3 +28,33 @@ void *gt_setup(const MunitParameter params[], void *fixture) {
     grim_init();
     return NULL;
 }
+
+// Bytecode for (lambda (x) (+ x 5))
+grim_object gt_make_adder() {
+    const char code[] = {
+        GRIM_BC_LOAD_ARG, 0,
+        GRIM_BC_LOAD_REF, 0,
+        GRIM_BC_LOAD_REF_CELL, 1,
+        GRIM_BC_CALL, 2,
+        GRIM_BC_RETURN
+    };
+    grim_object bytecode = grim_buffer_create(0);
+    grim_buffer_copy(bytecode, code, sizeof(code));
+
+    grim_object refs = grim_vector_create(2);
+    I_vectorelt(refs, 0) = grim_integer_pack(5);
+    I_vectorelt(refs, 1) = grim_module_cell(grim_builtin_module, grim_intern("+", NULL), true);
+    return grim_lfunc_create(bytecode, refs, 0, 1, false);
+}
+
+// Creates an empty file from a template such as "/tmp/grimtest-XXXXXX"
+void gt_temporary(char *path) {
+    int fd = mkstemp(path);
+    munit_assert_int(fd, >=, 0);
+    close(fd);
+}
+
+void gt_save_temporary(char *path, grim_object root) {
+    gt_temporary(path);
+    munit_assert_true(grim_image_save(path, root));
+}
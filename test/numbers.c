@@ -1,4 +1,7 @@
 #include <math.h>
+#include <string.h>
+
+#include "gc.h"
 
 #include "grim.h"
 #include "test.h"
@@ -19,6 +22,60 @@ static MunitResult floats(const MunitParameter params[], void *fixture) {
     return MUNIT_OK;
 }
 
+static MunitResult flonums(const MunitParameter params[], void *fixture) {
+    grim_object num;
+
+    num = grim_float_pack(0.0);
+    gta_is_flonum(num);
+    gta_check_float(num, 0.0);
+
+    num = grim_float_pack(-2.5);
+    gta_is_flonum(num);
+    gta_check_float(num, -2.5);
+
+    num = grim_float_pack(2e-19);
+    gta_is_flonum(num);
+    gta_check_float(num, 2e-19);
+
+    num = grim_float_pack(3e19);
+    gta_is_flonum(num);
+    gta_check_float(num, 3e19);
+
+    num = grim_float_pack(ldexp(1.0, -63));
+    gta_is_boxed_float(num);
+    gta_check_float(num, ldexp(1.0, -63));
+
+    num = grim_float_pack(-0.0);
+    gta_is_boxed_float(num);
+    munit_assert(signbit(grim_float_extract(num)));
+
+    num = grim_float_pack(1e300);
+    gta_is_boxed_float(num);
+    gta_check_float(num, 1e300);
+
+    num = grim_float_pack(-1e-300);
+    gta_is_boxed_float(num);
+    gta_check_float(num, -1e-300);
+
+    num = grim_float_pack(NAN);
+    gta_is_boxed_float(num);
+    munit_assert(isnan(grim_float_extract(num)));
+
+    munit_assert(grim_equal(grim_float_pack(1e300), grim_float_pack(1e300)));
+    munit_assert(!grim_equal(grim_float_pack(0.0), grim_float_pack(-0.0)));
+    munit_assert(grim_hash(grim_float_pack(1e300), 0) == grim_hash(grim_float_pack(1e300), 0));
+
+    num = grim_add(grim_float_pack(1.5), grim_float_pack(2.25), false);
+    gta_is_flonum(num);
+    gta_check_float(num, 3.75);
+
+    num = grim_add(grim_float_pack(1e300), grim_float_pack(1e300), true);
+    gta_is_flonum(num);
+    gta_check_float(num, 0.0);
+
+    return MUNIT_OK;
+}
+
 static MunitResult bigints(const MunitParameter params[], void *fixture) {
     grim_object max = grim_integer_pack(4611686018427387904);
     gta_check_bigint(max, "4611686018427387904");
@@ -69,16 +126,39 @@ static MunitResult complex(const MunitParameter params[], void *fixture) {
 
     cpl = grim_complex_pack(grim_integer_pack(1), grim_integer_pack(1));
     gta_is_complex(cpl);
-    gta_check_fixnum(I(cpl)->real, 1);
-    gta_check_fixnum(I(cpl)->imag, 1);
+    gta_check_fixnum(I_real(cpl), 1);
+    gta_check_fixnum(I_imag(cpl), 1);
 
     cpl = grim_complex_pack(grim_float_pack(3.1415), grim_float_pack(0.0));
     gta_check_float(cpl, 3.1415);
 
     cpl = grim_complex_pack(grim_float_pack(0.0), grim_float_pack(-1.0));
     gta_is_complex(cpl);
-    gta_check_float(I(cpl)->real, 0.0);
-    gta_check_float(I(cpl)->imag, -1.0);
+    gta_check_float(I_real(cpl), 0.0);
+    gta_check_float(I_imag(cpl), -1.0);
+
+    return MUNIT_OK;
+}
+
+static MunitResult collect(const MunitParameter params[], void *fixture) {
+    grim_object big = grim_integer_read("123456789012345678901234567890", 10);
+    grim_object rat = grim_rational_pack(
+        grim_integer_read("98765432109876543210987654321", 10),
+        grim_integer_read("1000000000000000000000000000000", 10));
+    grim_object flt = grim_float_pack(1e300);
+
+    // Churn through enough garbage to reuse any memory that the
+    // collector wrongly considers free
+    for (int i = 0; i < 5; i++) {
+        GC_gcollect();
+        for (int j = 0; j < 10000; j++)
+            grim_add(big, grim_integer_pack(j), false);
+    }
+
+    gta_check_bigint(big, "123456789012345678901234567890");
+    gta_check_bigint(grim_rational_num(rat), "98765432109876543210987654321");
+    gta_check_bigint(grim_rational_den(rat), "1000000000000000000000000000000");
+    gta_check_float(flt, 1e300);
 
     return MUNIT_OK;
 }
@@ -104,6 +184,12 @@ static MunitResult rawint(const MunitParameter params[], void *fixture) {
     num = grim_integer_read("99.99999._999999..999999999999__999#####", 10);
     gta_check_bigint(num, "999999999999999999999999999900000");
 
+    num = grim_ninteger_read("12345", 3, 10);
+    gta_check_fixnum(num, 123);
+
+    num = grim_ninteger_read("9999999999999999999999999999999999 1", 33, 10);
+    gta_check_bigint(num, "999999999999999999999999999999999");
+
     return MUNIT_OK;
 }
 
@@ -119,6 +205,9 @@ static MunitResult rawfloat(const MunitParameter params[], void *fixture) {
     num = grim_float_read("3_14##e-4");
     gta_check_float(num, 3.14);
 
+    num = grim_nfloat_read("2.51e3", 4);
+    gta_check_float(num, 2.51);
+
     return MUNIT_OK;
 }
 
@@ -200,6 +289,13 @@ static MunitResult parse_ints(const MunitParameter params[], void *fixture) {
     num = grim_read(grim_string_pack("999999999999999999999999999999999999999", NULL, false));
     gta_check_bigint(num, "999999999999999999999999999999999999999");
 
+    // Long enough to spill out of the reader's inline scratch space
+    char digits[1001];
+    memset(digits, '7', 1000);
+    digits[1000] = 0;
+    num = grim_read(grim_string_pack(digits, NULL, false));
+    gta_check_bigint(num, digits);
+
     return MUNIT_OK;
 }
 
@@ -311,9 +407,11 @@ static MunitResult parse_complex(const MunitParameter params[], void *fixture) {
 
 static MunitTest tests_numbers[] = {
     gta_basic(floats),
+    gta_basic(flonums),
     gta_basic(bigints),
     gta_basic(rationals),
     gta_basic(complex),
+    gta_basic(collect),
     gta_endtests,
 };
 
@@ -0,0 +1,271 @@
+#include <string.h>
+
+#include "gc.h"
+
+#include "grim.h"
+#include "internal.h"
+#include "test.h"
+
+
+// Lengths around the kernels' vector widths, so that every tail is run
+static const size_t lengths[] = {0, 1, 3, 4, 5, 31, 32, 33, 100, 4099};
+#define NLENGTHS (sizeof(lengths) / sizeof(lengths[0]))
+
+static grim_object read_one(const char *code) {
+    return grim_read(grim_string_pack(code, "UTF-8", false));
+}
+
+
+static MunitResult read(const MunitParameter params[], void *fixture) {
+    grim_object vec;
+
+    vec = read_one("#f64(1 2.5 -3 1/4)");
+    munit_assert_int(grim_type(vec), ==, GRIM_F64VECTOR);
+    munit_assert_size(I_numlen(vec), ==, 4);
+    munit_assert_double(I_f64data(vec)[0], ==, 1.0);
+    munit_assert_double(I_f64data(vec)[1], ==, 2.5);
+    munit_assert_double(I_f64data(vec)[2], ==, -3.0);
+    munit_assert_double(I_f64data(vec)[3], ==, 0.25);
+
+    vec = read_one("#s64(0 -1 9223372036854775807 -9223372036854775808)");
+    munit_assert_int(grim_type(vec), ==, GRIM_S64VECTOR);
+    munit_assert_size(I_numlen(vec), ==, 4);
+    munit_assert_llong(I_s64data(vec)[0], ==, 0);
+    munit_assert_llong(I_s64data(vec)[1], ==, -1);
+    munit_assert_llong(I_s64data(vec)[2], ==, INT64_MAX);
+    munit_assert_llong(I_s64data(vec)[3], ==, INT64_MIN);
+
+    vec = read_one("#u8(0 1 255)");
+    munit_assert_int(grim_type(vec), ==, GRIM_BYTEVECTOR);
+    munit_assert_size(I_numlen(vec), ==, 3);
+    munit_assert_uint8(I_u8data(vec)[0], ==, 0);
+    munit_assert_uint8(I_u8data(vec)[1], ==, 1);
+    munit_assert_uint8(I_u8data(vec)[2], ==, 255);
+
+    vec = read_one("#u8()");
+    munit_assert_int(grim_type(vec), ==, GRIM_BYTEVECTOR);
+    munit_assert_size(I_numlen(vec), ==, 0);
+
+    // Not to be confused with booleans
+    gta_is_false(read_one("#f"));
+    vec = read_one("(#f #f64(1))");
+    gta_is_false(I_car(vec));
+    munit_assert_int(grim_type(I_car(I_cdr(vec))), ==, GRIM_F64VECTOR);
+
+    // Many elements, past the reader's first scratch buffer
+    grim_object buf = grim_buffer_create(0);
+    grim_buffer_copy(buf, "#s64(", 5);
+    for (int i = 0; i < 1000; i++) {
+        char word[16];
+        int len = snprintf(word, sizeof(word), "%d ", i);
+        grim_buffer_copy(buf, word, len);
+    }
+    grim_buffer_copy(buf, ")", 1);
+    vec = grim_read(grim_nstring_pack(I_buf(buf), I_buflen(buf), NULL, false));
+    munit_assert_size(I_numlen(vec), ==, 1000);
+    for (int i = 0; i < 1000; i++)
+        munit_assert_llong(I_s64data(vec)[i], ==, i);
+
+    return MUNIT_OK;
+}
+
+static MunitResult print(const MunitParameter params[], void *fixture) {
+    grim_object buf;
+
+    buf = grim_buffer_create(0);
+    grim_encode_print(buf, read_one("#f64(1 2.5)"), "UTF-8");
+    gta_check_buffer(buf, 23, "#f64(1.000000 2.500000)");
+
+    buf = grim_buffer_create(0);
+    grim_encode_print(buf, read_one("#s64(-1 0 1)"), "UTF-8");
+    gta_check_buffer(buf, 12, "#s64(-1 0 1)");
+
+    buf = grim_buffer_create(0);
+    grim_encode_display(buf, read_one("#(#u8(255 7))"), "UTF-8");
+    gta_check_buffer(buf, 13, "#(#u8(255 7))");
+
+    buf = grim_buffer_create(0);
+    grim_encode_print(buf, grim_bytevector_create(0), "UTF-8");
+    gta_check_buffer(buf, 5, "#u8()");
+
+    return MUNIT_OK;
+}
+
+static MunitResult equal(const MunitParameter params[], void *fixture) {
+    munit_assert_true(grim_equal(read_one("#f64(1 2)"), read_one("#f64(1.0 2.0)")));
+    munit_assert_false(grim_equal(read_one("#f64(1 2)"), read_one("#f64(1 2 3)")));
+    munit_assert_false(grim_equal(read_one("#s64(1 2)"), read_one("#u8(1 2)")));
+
+    grim_object table = grim_hashtable_create(0);
+    grim_hashtable_set(table, read_one("#u8(1 2 3)"), grim_true);
+    gta_is_true(grim_hashtable_get(table, read_one("#u8(1 2 3)")));
+    munit_assert_false(grim_hashtable_has(table, read_one("#u8(1 2 4)")));
+
+    return MUNIT_OK;
+}
+
+static MunitResult f64(const MunitParameter params[], void *fixture) {
+    for (size_t k = 0; k < NLENGTHS; k++) {
+        size_t n = lengths[k];
+        grim_object a = grim_f64vector_create(n), b = grim_f64vector_create(n);
+        // Small integers, so that sums are exact in any order
+        for (size_t i = 0; i < n; i++) {
+            I_f64data(a)[i] = (double) ((i * 7) % 13) - 6;
+            I_f64data(b)[i] = (double) ((i * 5) % 11);
+        }
+
+        grim_object sum = grim_numvector_add(a, b), prod = grim_numvector_mul(a, b);
+        double total = 0, dot = 0, min = 1e300, max = -1e300;
+        for (size_t i = 0; i < n; i++) {
+            munit_assert_double(I_f64data(sum)[i], ==, I_f64data(a)[i] + I_f64data(b)[i]);
+            munit_assert_double(I_f64data(prod)[i], ==, I_f64data(a)[i] * I_f64data(b)[i]);
+            total += I_f64data(a)[i];
+            dot += I_f64data(a)[i] * I_f64data(b)[i];
+            if (I_f64data(a)[i] < min)
+                min = I_f64data(a)[i];
+            if (I_f64data(a)[i] > max)
+                max = I_f64data(a)[i];
+        }
+
+        gta_check_float(grim_numvector_sum(a), total);
+        gta_check_float(grim_numvector_dot(a, b), dot);
+        if (n == 0) {
+            gta_is_undefined(grim_numvector_min(a));
+            gta_is_undefined(grim_numvector_max(a));
+        }
+        else {
+            gta_check_float(grim_numvector_min(a), min);
+            gta_check_float(grim_numvector_max(a), max);
+        }
+    }
+
+    // The extremum may be in any lane, or in the tail
+    grim_object vec = grim_f64vector_create(11);
+    for (size_t pos = 0; pos < 11; pos++) {
+        memset(I_f64data(vec), 0, 11 * sizeof(double));
+        I_f64data(vec)[pos] = -1.5;
+        gta_check_float(grim_numvector_min(vec), -1.5);
+        I_f64data(vec)[pos] = 1.5;
+        gta_check_float(grim_numvector_max(vec), 1.5);
+    }
+
+    return MUNIT_OK;
+}
+
+static MunitResult s64(const MunitParameter params[], void *fixture) {
+    for (size_t k = 0; k < NLENGTHS; k++) {
+        size_t n = lengths[k];
+        grim_object a = grim_s64vector_create(n), b = grim_s64vector_create(n);
+        for (size_t i = 0; i < n; i++) {
+            I_s64data(a)[i] = (int64_t) ((i * 7919) % 1000) - 500;
+            I_s64data(b)[i] = (int64_t) ((i * 104729) % 333);
+        }
+
+        grim_object sum = grim_numvector_add(a, b), prod = grim_numvector_mul(a, b);
+        int64_t total = 0, dot = 0, min = INT64_MAX, max = INT64_MIN;
+        for (size_t i = 0; i < n; i++) {
+            munit_assert_llong(I_s64data(sum)[i], ==, I_s64data(a)[i] + I_s64data(b)[i]);
+            munit_assert_llong(I_s64data(prod)[i], ==, I_s64data(a)[i] * I_s64data(b)[i]);
+            total += I_s64data(a)[i];
+            dot += I_s64data(a)[i] * I_s64data(b)[i];
+            if (I_s64data(a)[i] < min)
+                min = I_s64data(a)[i];
+            if (I_s64data(a)[i] > max)
+                max = I_s64data(a)[i];
+        }
+
+        gta_check_fixnum(grim_numvector_sum(a), total);
+        gta_check_fixnum(grim_numvector_dot(a, b), dot);
+        if (n > 0) {
+            gta_check_fixnum(grim_numvector_min(a), min);
+            gta_check_fixnum(grim_numvector_max(a), max);
+        }
+    }
+
+    // Elementwise arithmetic wraps around
+    grim_object a = read_one("#s64(9223372036854775807 -9223372036854775808)");
+    grim_object b = read_one("#s64(1 -1)");
+    grim_object sum = grim_numvector_add(a, b);
+    munit_assert_llong(I_s64data(sum)[0], ==, INT64_MIN);
+    munit_assert_llong(I_s64data(sum)[1], ==, INT64_MAX);
+
+    // Reductions don't
+    a = read_one("#s64(9223372036854775807 9223372036854775807 9223372036854775807"
+                 " 9223372036854775807 9223372036854775807 1)");
+    gta_check_bigint(grim_numvector_sum(a), "46116860184273879036");
+    gta_check_bigint(grim_numvector_dot(a, a), "425352958651173079236984538921162506246");
+    a = read_one("#s64(-9223372036854775808 -9223372036854775808 -9223372036854775808"
+                 " -9223372036854775808 -9223372036854775808)");
+    gta_check_bigint(grim_numvector_sum(a), "-46116860184273879040");
+    gta_check_bigint(grim_numvector_dot(a, a), "425352958651173079329218259289710264320");
+
+    return MUNIT_OK;
+}
+
+static MunitResult bytes(const MunitParameter params[], void *fixture) {
+    for (size_t k = 0; k < NLENGTHS; k++) {
+        size_t n = lengths[k];
+        grim_object a = grim_bytevector_create(n), b = grim_bytevector_create(n);
+        for (size_t i = 0; i < n; i++) {
+            I_u8data(a)[i] = (i * 37 + 11) % 256;
+            I_u8data(b)[i] = 255 - i % 256;
+        }
+
+        grim_object sum = grim_numvector_add(a, b), prod = grim_numvector_mul(a, b);
+        int64_t total = 0, dot = 0, min = 255, max = 0;
+        for (size_t i = 0; i < n; i++) {
+            munit_assert_uint8(I_u8data(sum)[i], ==, (uint8_t) (I_u8data(a)[i] + I_u8data(b)[i]));
+            munit_assert_uint8(I_u8data(prod)[i], ==, (uint8_t) (I_u8data(a)[i] * I_u8data(b)[i]));
+            total += I_u8data(a)[i];
+            dot += I_u8data(a)[i] * I_u8data(b)[i];
+            if (I_u8data(a)[i] < min)
+                min = I_u8data(a)[i];
+            if (I_u8data(a)[i] > max)
+                max = I_u8data(a)[i];
+        }
+
+        gta_check_fixnum(grim_numvector_sum(a), total);
+        gta_check_fixnum(grim_numvector_dot(a, b), dot);
+        if (n > 0) {
+            gta_check_fixnum(grim_numvector_min(a), min);
+            gta_check_fixnum(grim_numvector_max(a), max);
+        }
+    }
+
+    // Long enough to flush the narrow accumulators several times
+    size_t n = 1 << 20;
+    grim_object a = grim_bytevector_create(n);
+    memset(I_u8data(a), 255, n);
+    gta_check_fixnum(grim_numvector_sum(a), 255 * (int64_t) n);
+    gta_check_fixnum(grim_numvector_dot(a, a), 255 * 255 * (int64_t) n);
+
+    return MUNIT_OK;
+}
+
+static MunitResult collect(const MunitParameter params[], void *fixture) {
+    grim_object vec = read_one("#f64(1 2 3 4 5 6 7 8 9 10)");
+    for (int i = 0; i < 10000; i++)
+        grim_f64vector_create(100);
+    GC_gcollect();
+    gta_check_float(grim_numvector_sum(vec), 55.0);
+    return MUNIT_OK;
+}
+
+
+MunitTest tests_numvectors[] = {
+    gta_basic(read),
+    gta_basic(print),
+    gta_basic(equal),
+    gta_basic(f64),
+    gta_basic(s64),
+    gta_basic(bytes),
+    gta_basic(collect),
+    gta_endtests,
+};
+
+MunitSuite suite_numvectors = {
+    "/numvectors",
+    tests_numvectors,
+    NULL,
+    1, MUNIT_SUITE_OPTION_NONE,
+};
@@ -1,3 +1,6 @@
+#include <stdio.h>
+#include <stdlib.h>
+
 #include "grim.h"
 #include "test.h"
 
@@ -20,6 +23,30 @@ static MunitResult basic(const MunitParameter params[], void *fixture) {
     return MUNIT_OK;
 }
 
+static MunitResult storage(const MunitParameter params[], void *fixture) {
+    grim_object str;
+
+    str = grim_nstring_pack("abcdefgh", 3, NULL, false);
+    gta_check_string(str, 3, "abc");
+    munit_assert_ptr_equal(I_str(str), IX(string, str)->sinline);
+    munit_assert_uint8(I_str(str)[3], ==, 0);
+
+    str = grim_string_pack("0123456789abcdef", NULL, false);
+    gta_check_string(str, 16, "0123456789abcdef");
+    munit_assert_ptr_equal(I_str(str), IX(string, str)->sinline);
+
+    str = grim_string_pack("0123456789abcdefg", NULL, false);
+    gta_check_string(str, 17, "0123456789abcdefg");
+    munit_assert(I_str(str) != IX(string, str)->sinline);
+    munit_assert_uint8(I_str(str)[17], ==, 0);
+
+    str = grim_string_pack("\\\\0123456789abcdef", "UTF-8", true);
+    gta_check_string(str, 17, "\\0123456789abcdef");
+    munit_assert_uint8(I_str(str)[17], ==, 0);
+
+    return MUNIT_OK;
+}
+
 static MunitResult escape(const MunitParameter params[], void *fixture) {
     grim_object str;
 
@@ -147,12 +174,66 @@ static MunitResult read(const MunitParameter params[], void *fixture) {
     return MUNIT_OK;
 }
 
+static MunitResult dump(const MunitParameter params[], void *fixture) {
+    char *out;
+    size_t len;
+    FILE *stream = open_memstream(&out, &len);
+
+    // Exactly what's in the buffer, not up to a NUL: the bytes past its
+    // length are left over, and it may hold a NUL of its own
+    grim_object buf = grim_buffer_create(0);
+    grim_buffer_copy(buf, "left over", 9);
+    I_buflen(buf) = 0;
+    grim_encode_display(buf, grim_string_pack("\\a\\0", "UTF-8", true), "UTF-8");
+    grim_buffer_dump(stream, buf);
+    fclose(stream);
+    munit_assert_size(len, ==, 2);
+    munit_assert_memory_equal(2, out, "\x07\x00");
+    free(out);
+    return MUNIT_OK;
+}
+
+static MunitResult hash(const MunitParameter params[], void *fixture) {
+    grim_object a = grim_string_pack("a string long enough to be stored apart", NULL, false);
+    grim_object b = grim_string_pack("a string long enough to be stored apart", NULL, false);
+    grim_object c = grim_string_pack("a string long enough to be stored apart!", NULL, false);
+    munit_assert_uint32(I_strhash(a), ==, 0);
+
+    // Worked out once, and the same for equal strings
+    uint64_t h = grim_hash(a, 0);
+    munit_assert_uint32(I_strhash(a), !=, 0);
+    munit_assert_true(grim_hash(a, 0) == h);
+    munit_assert_true(grim_hash(b, 0) == h);
+    munit_assert_true(grim_hash(c, 0) != h);
+    munit_assert_true(grim_hash(a, 1) != h);
+    munit_assert_true(grim_equal(a, b));
+    munit_assert_false(grim_equal(a, c));
+
+    // Unescaping changes the contents, and so the hash
+    grim_object d = grim_string_pack("tab\\t", NULL, false);
+    grim_object e = grim_string_pack("tab\\t", NULL, true);
+    grim_object f = grim_string_pack("tab\\t", NULL, false);
+    grim_hash(d, 0);
+    munit_assert_uint32(I_strhash(e), ==, 0);
+    munit_assert_true(grim_hash(e, 0) != grim_hash(d, 0));
+    munit_assert_true(grim_hash(f, 0) == grim_hash(d, 0));
+
+    // Symbol names start out with their hash
+    grim_object name = I_symbolname(grim_intern("a-symbol", NULL));
+    munit_assert_uint32(I_strhash(name), !=, 0);
+    munit_assert_true(grim_hash(name, 0) == grim_hash(grim_string_pack("a-symbol", NULL, false), 0));
+    return MUNIT_OK;
+}
+
 MunitTest tests_strings[] = {
     gta_basic(basic),
+    gta_basic(storage),
     gta_basic(escape),
     gta_basic(display),
     gta_basic(print),
+    gta_basic(dump),
     gta_basic(read),
+    gta_basic(hash),
     gta_endtests,
 };
 
@@ -1,3 +1,7 @@
+#include <stdio.h>
+
+#include "gc.h"
+
 #include "grim.h"
 #include "test.h"
 
@@ -29,10 +33,28 @@ static MunitResult read(const MunitParameter params[], void *fixture) {
     return MUNIT_OK;
 }
 
+static MunitResult many(const MunitParameter params[], void *fixture) {
+    grim_object syms[5000];
+    char name[32];
+    for (int i = 0; i < 5000; i++) {
+        snprintf(name, sizeof(name), "symbol-%d", i);
+        syms[i] = grim_intern(name, NULL);
+    }
+    GC_gcollect();
+    for (int i = 0; i < 5000; i++) {
+        int length = snprintf(name, sizeof(name), "symbol-%d", i);
+        gta_check_symbol(syms[i], length, name);
+        gta_check_repr(grim_intern(name, NULL), syms[i]);
+        munit_assert(grim_equal(I_symbolname(syms[i]), grim_string_pack(name, NULL, false)));
+    }
+    return MUNIT_OK;
+}
+
 
 static MunitTest tests_symbols[] = {
     gta_basic(equality),
     gta_basic(read),
+    gta_basic(many),
     gta_endtests,
 };
 
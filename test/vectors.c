@@ -1,4 +1,7 @@
+#include <stdio.h>
+
 #include "grim.h"
+#include "internal.h"
 #include "test.h"
 
 
@@ -72,10 +75,102 @@ static MunitResult read_multi(const MunitParameter params[], void *fixture) {
     return MUNIT_OK;
 }
 
+static MunitResult read_long(const MunitParameter params[], void *fixture) {
+    grim_object buf = grim_buffer_create(0);
+    grim_buffer_copy(buf, "#(", 2);
+    for (int i = 0; i < 1000; i++) {
+        char word[16];
+        int len = snprintf(word, sizeof(word), "%d ", i);
+        grim_buffer_copy(buf, word, len);
+    }
+    grim_buffer_copy(buf, "(a . b))", 8);
+
+    grim_object vec = grim_read(grim_nstring_pack(I_buf(buf), I_buflen(buf), NULL, false));
+    gta_check_vector(vec, 1001);
+    for (int i = 0; i < 1000; i++)
+        gta_check_fixnum(I_vectorelt(vec, i), i);
+    gta_is_cons(I_vectorelt(vec, 1000));
+
+    return MUNIT_OK;
+}
+
+static MunitResult push(const MunitParameter params[], void *fixture) {
+    grim_object vec = grim_vector_create(0);
+    gta_check_vector(vec, 0);
+    for (int i = 0; i < 5000; i++)
+        grim_vector_push(vec, grim_integer_pack(i));
+    gta_check_vector(vec, 5000);
+    munit_assert_size(I_vectorcap(vec), >=, 5000);
+    munit_assert_size(I_vectorcap(vec), <, 10000);
+    for (int i = 0; i < 5000; i++)
+        gta_check_fixnum(I_vectorelt(vec, i), i);
+
+    vec = grim_vector_create(3);
+    grim_vector_reserve(vec, 100);
+    gta_check_vector(vec, 3);
+    munit_assert_size(I_vectorcap(vec), ==, 100);
+    gta_is_undefined(I_vectorelt(vec, 2));
+    grim_vector_push(vec, grim_true);
+    gta_check_vector(vec, 4);
+    munit_assert_size(I_vectorcap(vec), ==, 100);
+    gta_is_true(I_vectorelt(vec, 3));
+
+    return MUNIT_OK;
+}
+
+static MunitResult copy(const MunitParameter params[], void *fixture) {
+    grim_object vec = grim_vector_create(10);
+    for (int i = 0; i < 10; i++)
+        I_vectorelt(vec, i) = grim_integer_pack(i);
+
+    // Overlapping, forwards
+    grim_vector_copy(vec, 2, vec, 0, 5);
+    int expected[] = {0, 1, 0, 1, 2, 3, 4, 7, 8, 9};
+    for (int i = 0; i < 10; i++)
+        gta_check_fixnum(I_vectorelt(vec, i), expected[i]);
+
+    // Overlapping, backwards
+    grim_vector_copy(vec, 0, vec, 5, 10);
+    int expected2[] = {3, 4, 7, 8, 9, 3, 4, 7, 8, 9};
+    for (int i = 0; i < 10; i++)
+        gta_check_fixnum(I_vectorelt(vec, i), expected2[i]);
+
+    grim_object other = grim_vector_create(3);
+    grim_vector_copy(other, 1, vec, 1, 3);
+    gta_is_undefined(I_vectorelt(other, 0));
+    gta_check_fixnum(I_vectorelt(other, 1), 4);
+    gta_check_fixnum(I_vectorelt(other, 2), 7);
+
+    return MUNIT_OK;
+}
+
+static MunitResult fill(const MunitParameter params[], void *fixture) {
+    grim_object vec = grim_vector_create(1000);
+    for (int i = 0; i < 1000; i++)
+        gta_is_undefined(I_vectorelt(vec, i));
+
+    grim_vector_fill(vec, grim_true, 10, 999);
+    for (int i = 0; i < 1000; i++) {
+        if (i < 10 || i == 999)
+            gta_is_undefined(I_vectorelt(vec, i));
+        else
+            gta_is_true(I_vectorelt(vec, i));
+    }
+
+    grim_vector_fill(vec, grim_nil, 0, 0);
+    gta_is_undefined(I_vectorelt(vec, 0));
+
+    return MUNIT_OK;
+}
+
 
 static MunitTest tests_vectors[] = {
     gta_test("simple", read_simple),
     gta_test("multi", read_multi),
+    gta_test("long", read_long),
+    gta_basic(push),
+    gta_basic(copy),
+    gta_basic(fill),
     gta_endtests,
 };
 